@@ -0,0 +1,128 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ Arena::CreateMessage throughput of the libprotobuf built from Source/resources
+ (the protobuf_source target).
+
+ Every allocation from an arena goes through the arena's per-thread block cache,
+ so this measures how cheap that lookup is in the library's build mode. The
+ message is the library's own arena-enabled Timestamp, since the plugin's
+ messages are not built with cc_enable_arenas. ArenaBenchmark uses the DLL
+ build (PROTOBUF_USE_DLLS, as the plugin does) and ArenaBenchmarkStatic the
+ default one.
+
+ With "recycle", the arena keeps its blocks across Reset() (ArenaOptions::
+ recycle_blocks) and the blocks it still had to allocate after the first round
+ are reported; in steady state there should be none.
+
+ Usage: ArenaBenchmark [messages per round] [rounds] [threads] [recycle]
+*/
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/timestamp.pb.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Creates messagesPerRound messages on one arena per round, resetting it in between.
+    Returns the best round's time per message in nanoseconds, and the number of blocks
+    allocated after the first round in blocksAfterWarmUp. */
+static double createMessages (int messagesPerRound, int rounds, bool recycle, uint64_t* blocksAfterWarmUp)
+{
+    google::protobuf::ArenaOptions options;
+    options.recycle_blocks = recycle;
+
+    google::protobuf::Arena arena (options);
+    double best = 0;
+    uint64_t blocksAfterFirstRound = 0;
+
+    for (int round = 0; round < rounds; round++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < messagesPerRound; i++)
+        {
+            auto* timestamp = google::protobuf::Arena::CreateMessage<google::protobuf::Timestamp> (&arena);
+            timestamp->set_seconds (i);
+        }
+
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const double perMessage = std::chrono::duration<double, std::nano> (elapsed).count() / messagesPerRound;
+
+        if (round == 0 || perMessage < best)
+            best = perMessage;
+
+        if (round == 0)
+            blocksAfterFirstRound = arena.GetBlockStats().blocks_allocated;
+
+        arena.Reset();
+    }
+
+    *blocksAfterWarmUp = arena.GetBlockStats().blocks_allocated - blocksAfterFirstRound;
+    return best;
+}
+
+int main (int argc, char** argv)
+{
+    const int messagesPerRound = argc > 1 ? atoi (argv[1]) : 100000;
+    const int rounds = argc > 2 ? atoi (argv[2]) : 50;
+    const int numThreads = argc > 3 ? atoi (argv[3]) : 1;
+    const bool recycle = argc > 4 && std::string (argv[4]) == "recycle";
+
+#ifdef PROTOBUF_USE_DLLS
+    const char* buildMode = "PROTOBUF_USE_DLLS";
+#else
+    const char* buildMode = "default";
+#endif
+
+    std::vector<double> perMessage (numThreads);
+    std::vector<uint64_t> blocksAfterWarmUp (numThreads);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back ([&perMessage, &blocksAfterWarmUp, t, messagesPerRound, rounds, recycle]
+                              { perMessage[t] = createMessages (messagesPerRound, rounds, recycle, &blocksAfterWarmUp[t]); });
+
+    for (auto& thread : threads)
+        thread.join();
+
+    const double worst = *std::max_element (perMessage.begin(), perMessage.end());
+
+    std::cout << "build mode:       " << buildMode << std::endl;
+    std::cout << "threads:          " << numThreads << std::endl;
+    std::cout << "recycle blocks:   " << (recycle ? "yes" : "no") << std::endl;
+    std::cout << "ns per message:   " << worst << std::endl;
+    std::cout << "messages per sec: " << 1.0e9 * numThreads / worst << std::endl;
+    std::cout << "blocks allocated after the first round: "
+              << *std::max_element (blocksAfterWarmUp.begin(), blocksAfterWarmUp.end()) << std::endl;
+
+    google::protobuf::ShutdownProtobufLibrary();
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ Standalone latency and throughput benchmark for the Protobuf plugin's message path.
+
+ A stand-in for the AIBS middleware router binds a ROUTER socket on an inproc://
+ (or ipc://) endpoint and drives the plugin side, which runs the same Endpoint,
+ MessageDispatcher and OutboundQueue code as ProtobufPlugin::run(), with a
+ configurable mix of request_system_status, acquisition and recording messages.
+ No GUI and no network are needed.
+
+ Usage: ProtobufBenchmark [messages] [status%] [acquisition%] [recording%] [inproc|ipc]
+*/
+
+#include "../Source/ArrivalClock.h"
+#include "../Source/MessageDispatcher.h"
+#include "../Source/Endpoint.h"
+#include "../Source/HeaderTemplate.h"
+
+#include "../Source/resources/ephys_edi.pb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const char* PLUGIN_IDENTITY = "OpenEphys_benchmark";
+
+/** Plugin side: the same receive, dispatch and send path as ProtobufPlugin::run() */
+class PluginSide
+{
+public:
+
+    PluginSide (void* context_, const std::string& url_)
+        : shouldExit (false)
+        , handled (0)
+        , ready (false)
+        , context (context_)
+        , router (routerConfig (url_), 4096)
+        , lastCommand (0)
+    {
+        headerTemplate.set ("Open_Ephys", "benchmark");
+
+        dispatcher.add<request_system_status> ("request_system_status",
+            [this] (const request_system_status&) { handleStatus(); });
+        dispatcher.add<acquisition> ("acquisition",
+            [this] (const acquisition& m) { lastCommand = m.command(); });
+        dispatcher.add<recording> ("recording",
+            [this] (const recording& m) { lastCommand = m.command(); });
+    }
+
+    void start() { thread = std::thread ([this] { run(); }); }
+
+    void stop()
+    {
+        shouldExit = true;
+        thread.join();
+    }
+
+    std::atomic<bool> shouldExit;
+    std::atomic<uint64_t> handled;
+    std::atomic<bool> ready;
+
+private:
+
+    void run()
+    {
+        if (! router.open (context, PLUGIN_IDENTITY, 1000))
+            return;
+
+        for (int i = 0; i < dispatcher.getNumHandlers(); i++)
+        {
+            register_for_message message;
+            fillHeader (message.mutable_header(), dispatcher.getMessageId (i));
+            message.set_message_id (dispatcher.getMessageId (i));
+            router.send ("router", "register_for_message", message.SerializeAsString());
+        }
+
+        ready = true;
+
+        Endpoint::MessageCallback callback = [this] (const char* id, size_t idLength,
+                                                         const void* data, size_t size, int64_t)
+        {
+            const int handlerIndex = dispatcher.find (id, idLength);
+
+            if (handlerIndex >= 0 && dispatcher.parse (handlerIndex, data, size))
+                dispatcher.handle (handlerIndex);
+
+            handled++;
+        };
+
+        EndpointPoller poller;
+        poller.build (std::vector<Endpoint*> (1, &router), nullptr);
+
+        std::vector<int> readySockets;
+        readySockets.reserve (1);
+
+        while (! shouldExit)
+        {
+            if (poller.poll (router.getSendQueue().getDepth() > 0 ? 1 : 100, readySockets) > 0)
+                router.receive (callback);
+
+            router.flush();
+        }
+
+        router.close();
+    }
+
+    void handleStatus()
+    {
+        // built the way ProtobufPlugin builds its replies
+        static const std::string id = "system_status";
+
+        status.Clear();
+        status.set_status (system_status_status_type_READY);
+        status.set_source_message_id ("request_system_status");
+        status.set_message ("send_queue_depth=" + std::to_string (router.getSendQueue().getDepth()));
+
+        headerTemplate.serialize (status, id, float (ArrivalClock::secondsSinceOrigin()), &replyBuffer);
+        router.send ("router", id, replyBuffer);
+    }
+
+    static EndpointConfig routerConfig (const std::string& url)
+    {
+        EndpointConfig config;
+        config.name = "router";
+        config.type = ZMQ_ROUTER;
+        config.url = url;
+        return config;
+    }
+
+    static void fillHeader (message_header* header, const std::string& id)
+    {
+        header->set_host ("benchmark");
+        header->set_process ("Open_Ephys");
+        header->set_timestamp (float (ArrivalClock::secondsSinceOrigin()));
+        header->set_message_id (id);
+    }
+
+    void* context;
+
+    Endpoint router;
+    MessageDispatcher dispatcher;
+
+    HeaderTemplate headerTemplate;
+    system_status status;
+    std::string replyBuffer;
+
+    int lastCommand;
+
+    std::thread thread;
+};
+
+/** Stand-in router: sends a message frame triple to the plugin */
+static void sendToPlugin (void* socket, const std::string& id, const std::string& payload)
+{
+    zmq_send (socket, PLUGIN_IDENTITY, strlen (PLUGIN_IDENTITY), ZMQ_SNDMORE);
+    zmq_send (socket, id.data(), id.length(), ZMQ_SNDMORE);
+    zmq_send (socket, payload.data(), payload.length(), 0);
+}
+
+/** Stand-in router: receive one multipart message and return its message id */
+static std::string receiveFromPlugin (void* socket, zmq_msg_t* frame)
+{
+    std::string id;
+    int frameNum = 0;
+
+    do
+    {
+        if (zmq_msg_recv (frame, socket, 0) < 0)
+            return std::string();
+
+        if (frameNum == 2)
+            id.assign (static_cast<const char*> (zmq_msg_data (frame)), zmq_msg_size (frame));
+
+        frameNum++;
+    }
+    while (zmq_msg_more (frame));
+
+    return id;
+}
+
+static double percentile (const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+
+    size_t index = size_t (p * double (sorted.size() - 1) + 0.5);
+    return sorted[std::min (index, sorted.size() - 1)];
+}
+
+int main (int argc, char** argv)
+{
+    const int numMessages = argc > 1 ? atoi (argv[1]) : 100000;
+    const int statusWeight = argc > 2 ? atoi (argv[2]) : 80;
+    const int acquisitionWeight = argc > 3 ? atoi (argv[3]) : 10;
+    const int recordingWeight = argc > 4 ? atoi (argv[4]) : 10;
+    const std::string transport = argc > 5 ? argv[5] : "inproc";
+
+    const std::string url = transport == "ipc" ? "ipc:///tmp/protobuf-benchmark" : "inproc://protobuf-benchmark";
+
+    void* context = zmq_ctx_new();
+
+    // the stand-in router must be bound before an inproc peer can connect
+    void* router = zmq_socket (context, ZMQ_ROUTER);
+    int mandatory = 1;
+    zmq_setsockopt (router, ZMQ_IDENTITY, "router", 6);
+    zmq_setsockopt (router, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof mandatory);
+
+    if (zmq_bind (router, url.c_str()) != 0)
+    {
+        std::cerr << "Failed to bind " << url << ": " << zmq_strerror (zmq_errno()) << std::endl;
+        return 1;
+    }
+
+    PluginSide plugin (context, url);
+    plugin.start();
+
+    zmq_msg_t frame;
+    zmq_msg_init (&frame);
+
+    // wait for the plugin's registrations, which also makes it routable
+    const int64_t connectStart = ArrivalClock::nowNanos();
+    int registrations = 0;
+
+    while (registrations < 3)
+    {
+        if (receiveFromPlugin (router, &frame) == "register_for_message")
+            registrations++;
+    }
+
+    const double timeToReady = double (ArrivalClock::nowNanos() - connectStart) * 1.0e-6;
+
+    request_system_status statusRequest;
+    statusRequest.mutable_header()->set_message_id ("request_system_status");
+    const std::string statusPayload = statusRequest.SerializeAsString();
+
+    acquisition acquisitionCommand;
+    acquisitionCommand.mutable_header()->set_message_id ("acquisition");
+    acquisitionCommand.set_command (acquisition_command_type_START);
+    const std::string acquisitionPayload = acquisitionCommand.SerializeAsString();
+
+    recording recordingCommand;
+    recordingCommand.mutable_header()->set_message_id ("recording");
+    recordingCommand.set_command (recording_command_type_START);
+    const std::string recordingPayload = recordingCommand.SerializeAsString();
+
+    std::mt19937 rng (1234);
+    std::discrete_distribution<int> mix ({ double (statusWeight), double (acquisitionWeight), double (recordingWeight) });
+
+    std::vector<double> roundTrips;
+    roundTrips.reserve (numMessages);
+
+    const int64_t start = ArrivalClock::nowNanos();
+
+    for (int i = 0; i < numMessages; i++)
+    {
+        switch (mix (rng))
+        {
+            case 0:
+            {
+                const int64_t sent = ArrivalClock::nowNanos();
+                sendToPlugin (router, "request_system_status", statusPayload);
+
+                while (receiveFromPlugin (router, &frame) != "system_status") { }
+
+                roundTrips.push_back (double (ArrivalClock::nowNanos() - sent) * 1.0e-3);
+                break;
+            }
+            case 1:
+                sendToPlugin (router, "acquisition", acquisitionPayload);
+                break;
+            default:
+                sendToPlugin (router, "recording", recordingPayload);
+                break;
+        }
+    }
+
+    // one-way commands have no reply; wait until the plugin has handled all of them
+    while (plugin.handled < uint64_t (numMessages))
+        std::this_thread::yield();
+
+    const double elapsed = double (ArrivalClock::nowNanos() - start) * 1.0e-9;
+
+    plugin.stop();
+
+    std::sort (roundTrips.begin(), roundTrips.end());
+
+    std::cout << "Transport:          " << url << std::endl;
+    std::cout << "Messages:           " << numMessages << " (" << statusWeight << "% status, "
+              << acquisitionWeight << "% acquisition, " << recordingWeight << "% recording)" << std::endl;
+    std::cout << "Time to ready:      " << timeToReady << " ms" << std::endl;
+    std::cout << "Throughput:         " << double (numMessages) / elapsed << " messages/s" << std::endl;
+    std::cout << "Round trip p50:     " << percentile (roundTrips, 0.5) << " us" << std::endl;
+    std::cout << "Round trip p99:     " << percentile (roundTrips, 0.99) << " us" << std::endl;
+    std::cout << "Round trip p99.9:   " << percentile (roundTrips, 0.999) << " us" << std::endl;
+
+    zmq_msg_close (&frame);
+    zmq_close (router);
+    zmq_ctx_destroy (context);
+
+    return 0;
+}
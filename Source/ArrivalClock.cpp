@@ -0,0 +1,133 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ArrivalClock.h"
+
+#include <chrono>
+
+/** Weight kept by older sync points each block; about ten seconds of history at typical block sizes */
+const double FORGETTING_FACTOR = 0.999;
+
+static const int64_t clockOrigin = ArrivalClock::nowNanos();
+
+ArrivalClock::ArrivalClock()
+    : sequence (0)
+{
+    reset();
+}
+
+int64_t ArrivalClock::nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double ArrivalClock::secondsSinceOrigin()
+{
+    return double (nowNanos() - clockOrigin) * 1.0e-9;
+}
+
+void ArrivalClock::reset()
+{
+    originNanos = 0;
+    originSample = 0;
+    sw = sx = sy = sxx = sxy = 0;
+    numPoints = 0;
+
+    sequence.fetch_add (1, std::memory_order_acq_rel);
+    published.valid = false;
+    sequence.fetch_add (1, std::memory_order_release);
+}
+
+void ArrivalClock::addSyncPoint (int64_t hostNanos, int64_t sampleNumber)
+{
+    if (numPoints == 0)
+    {
+        // fit relative to the first point so the sums keep their precision
+        originNanos = hostNanos;
+        originSample = sampleNumber;
+    }
+
+    const double x = double (hostNanos - originNanos) * 1.0e-9;
+    const double y = double (sampleNumber - originSample);
+
+    sw  = FORGETTING_FACTOR * sw  + 1.0;
+    sx  = FORGETTING_FACTOR * sx  + x;
+    sy  = FORGETTING_FACTOR * sy  + y;
+    sxx = FORGETTING_FACTOR * sxx + x * x;
+    sxy = FORGETTING_FACTOR * sxy + x * y;
+    numPoints++;
+
+    const double denominator = sw * sxx - sx * sx;
+
+    if (numPoints < 2 || denominator <= 0)
+        return;
+
+    Fit fit;
+    fit.originNanos = originNanos;
+    fit.originSample = originSample;
+    fit.slope = (sw * sxy - sx * sy) / denominator;
+    fit.intercept = (sy - fit.slope * sx) / sw;
+    fit.valid = true;
+
+    // odd sequence numbers tell readers an update is in progress
+    sequence.fetch_add (1, std::memory_order_acq_rel);
+    published = fit;
+    sequence.fetch_add (1, std::memory_order_release);
+}
+
+ArrivalClock::Fit ArrivalClock::readFit() const
+{
+    Fit fit;
+    uint32_t before, after;
+
+    do
+    {
+        before = sequence.load (std::memory_order_acquire);
+        fit = published;
+        std::atomic_thread_fence (std::memory_order_acquire);
+        after = sequence.load (std::memory_order_relaxed);
+    }
+    while ((before & 1) != 0 || before != after);
+
+    return fit;
+}
+
+int64_t ArrivalClock::toSampleNumber (int64_t hostNanos) const
+{
+    const Fit fit = readFit();
+
+    if (! fit.valid)
+        return -1;
+
+    const double x = double (hostNanos - fit.originNanos) * 1.0e-9;
+
+    return fit.originSample + int64_t (fit.intercept + fit.slope * x + 0.5);
+}
+
+double ArrivalClock::getSampleRateEstimate() const
+{
+    const Fit fit = readFit();
+
+    return fit.valid ? fit.slope : 0;
+}
@@ -0,0 +1,94 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __ARRIVALCLOCK_H_5D0C6A39__
+#define __ARRIVALCLOCK_H_5D0C6A39__
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ Maps a monotonic host clock onto the processor's sample counter.
+
+ process() adds a sync point every block; a running least-squares fit with
+ exponential forgetting follows drift between the host clock and the
+ acquisition clock. Any thread can then convert a host time captured when a
+ message arrived into the sample number it lines up with.
+
+ addSyncPoint() and reset() must be called from one thread at a time; the
+ conversion functions are lock-free and safe from any thread.
+*/
+class ArrivalClock
+{
+public:
+
+    /** Constructor */
+    ArrivalClock();
+
+    /** Monotonic host time in nanoseconds */
+    static int64_t nowNanos();
+
+    /** Seconds on the monotonic clock since the plugin was loaded */
+    static double secondsSinceOrigin();
+
+    /** Forget the fit, e.g. when the sample counter restarts */
+    void reset();
+
+    /** Record that sampleNumber was the newest sample at host time hostNanos */
+    void addSyncPoint (int64_t hostNanos, int64_t sampleNumber);
+
+    /** Sample number corresponding to a host time, or -1 before two sync points exist */
+    int64_t toSampleNumber (int64_t hostNanos) const;
+
+    /** Current estimate of samples per host second, or 0 before two sync points exist */
+    double getSampleRateEstimate() const;
+
+private:
+
+    struct Fit
+    {
+        int64_t originNanos;
+        int64_t originSample;
+        double slope;       // samples per second
+        double intercept;   // samples at originNanos
+        bool valid;
+    };
+
+    /** Copy the published fit, retrying if a writer was mid-update */
+    Fit readFit() const;
+
+    // accumulated by the writer only
+    int64_t originNanos;
+    int64_t originSample;
+    double sw, sx, sy, sxx, sxy;
+    int numPoints;
+
+    // seqlock-protected copy for readers
+    std::atomic<uint32_t> sequence;
+    Fit published;
+
+    ArrivalClock (const ArrivalClock&) = delete;
+    ArrivalClock& operator= (const ArrivalClock&) = delete;
+};
+
+#endif  // __ARRIVALCLOCK_H_5D0C6A39__
@@ -0,0 +1,375 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CaptureFile.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <google/protobuf/wire_format_lite_inl.h>
+
+#include <fcntl.h>
+#include <iostream>
+
+#ifdef WIN32
+    #include <io.h>
+    #define OPEN_FILE _open
+    #define CAPTURE_OPEN_FLAGS (_O_BINARY)
+#else
+    #include <unistd.h>
+    #define OPEN_FILE ::open
+    #define CAPTURE_OPEN_FLAGS 0
+#endif
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+/** Records per block; the writer is woken once a block is this full */
+const int CAPTURE_BLOCK_RECORDS = 4096;
+const int CAPTURE_WAKE_RECORDS = CAPTURE_BLOCK_RECORDS / 4;
+
+/** Longest the writer waits before writing a partly filled block */
+const int CAPTURE_FLUSH_MS = 100;
+
+/** Frame buffers bigger than this are released after writing */
+const size_t MAX_RETAINED_FRAME_SIZE = 1 << 16;
+
+/*********************************************/
+CaptureRecord::CaptureRecord()
+    : timestampNanos (0)
+    , direction (RECEIVED)
+    , endpoint (0)
+    , numFrames (0)
+    , cachedSize (0)
+{
+}
+
+void CaptureRecord::addFrame (const void* data, size_t size)
+{
+    if (numFrames == int (frames.size()))
+        frames.emplace_back();
+
+    frames[numFrames++].assign (static_cast<const char*> (data), size);
+}
+
+void CaptureRecord::Clear()
+{
+    timestampNanos = 0;
+    direction = RECEIVED;
+    endpoint = 0;
+    numFrames = 0;
+}
+
+void CaptureRecord::CheckTypeAndMergeFrom (const google::protobuf::MessageLite& other)
+{
+    const CaptureRecord& from = static_cast<const CaptureRecord&> (other);
+
+    timestampNanos = from.timestampNanos;
+    direction = from.direction;
+    endpoint = from.endpoint;
+
+    for (int i = 0; i < from.numFrames; i++)
+        addFrame (from.frames[i].data(), from.frames[i].length());
+}
+
+bool CaptureRecord::MergePartialFromCodedStream (CodedInputStream* input)
+{
+    while (true)
+    {
+        const uint32_t tag = input->ReadTag();
+
+        if (tag == 0)
+            return true;
+
+        google::protobuf::uint64 value64;
+        google::protobuf::uint32 value32;
+
+        switch (WireFormatLite::GetTagFieldNumber (tag))
+        {
+            case 1:
+                if (! input->ReadVarint64 (&value64))
+                    return false;
+                timestampNanos = int64_t (value64);
+                break;
+
+            case 2:
+                if (! input->ReadVarint32 (&value32))
+                    return false;
+                direction = value32;
+                break;
+
+            case 3:
+                if (! input->ReadVarint32 (&value32))
+                    return false;
+                endpoint = value32;
+                break;
+
+            case 4:
+                if (numFrames == int (frames.size()))
+                    frames.emplace_back();
+
+                if (! WireFormatLite::ReadBytes (input, &frames[numFrames]))
+                    return false;
+                numFrames++;
+                break;
+
+            default:
+                if (! WireFormatLite::SkipField (input, tag))
+                    return false;
+                break;
+        }
+    }
+}
+
+size_t CaptureRecord::ByteSizeLong() const
+{
+    size_t size = 1 + CodedOutputStream::VarintSize64 (uint64_t (timestampNanos))
+                + 1 + CodedOutputStream::VarintSize32 (direction)
+                + 1 + CodedOutputStream::VarintSize32 (endpoint);
+
+    for (int i = 0; i < numFrames; i++)
+        size += 1 + WireFormatLite::BytesSize (frames[i]);
+
+    cachedSize = int (size);
+    return size;
+}
+
+void CaptureRecord::SerializeWithCachedSizes (CodedOutputStream* output) const
+{
+    WireFormatLite::WriteInt64 (1, timestampNanos, output);
+    WireFormatLite::WriteUInt32 (2, direction, output);
+    WireFormatLite::WriteUInt32 (3, endpoint, output);
+
+    for (int i = 0; i < numFrames; i++)
+        WireFormatLite::WriteBytes (4, frames[i], output);
+}
+
+/*********************************************/
+CaptureWriter::CaptureWriter()
+    : frontBlock    (0)
+    , frontCount    (0)
+    , active        (false)
+    , shouldExit    (false)
+    , recordCount   (0)
+    , droppedCount  (0)
+    , bytesWritten  (0)
+{
+    blocks[0] = std::vector<CaptureRecord> (CAPTURE_BLOCK_RECORDS);
+    blocks[1] = std::vector<CaptureRecord> (CAPTURE_BLOCK_RECORDS);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open (const std::string& path_)
+{
+    close();
+
+    const int fd = OPEN_FILE (path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | CAPTURE_OPEN_FLAGS, 0644);
+
+    if (fd < 0)
+    {
+        std::cout << "Could not create capture file " << path_ << std::endl;
+        return false;
+    }
+
+    path = path_;
+    // closed explicitly in close(), which also flushes
+    file.reset (new google::protobuf::io::FileOutputStream (fd));
+
+    frontCount = 0;
+    shouldExit = false;
+    recordCount = 0;
+    droppedCount = 0;
+    bytesWritten = 0;
+
+    thread = std::thread ([this] { run(); });
+    active = true;
+
+    std::cout << "Capturing messages to " << path << std::endl;
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if (! thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> sl (lock);
+        active = false;
+        shouldExit = true;
+    }
+
+    blockReady.notify_one();
+    thread.join();
+
+    file->Close();
+    file.reset();
+
+    std::cout << "Captured " << recordCount << " messages (" << droppedCount << " dropped) to " << path << std::endl;
+}
+
+void CaptureWriter::record (CaptureRecord::Direction direction, uint32_t endpoint, int64_t timestampNanos,
+                            const CaptureFrame* frames, int numFrames)
+{
+    if (! active)
+        return;
+
+    bool wakeWriter;
+
+    {
+        std::lock_guard<std::mutex> sl (lock);
+
+        if (! active)
+            return;
+
+        if (frontCount == CAPTURE_BLOCK_RECORDS)
+        {
+            droppedCount++;
+            return;
+        }
+
+        CaptureRecord& record = blocks[frontBlock][frontCount++];
+        record.Clear();
+        record.timestampNanos = timestampNanos;
+        record.direction = direction;
+        record.endpoint = endpoint;
+
+        for (int i = 0; i < numFrames; i++)
+            record.addFrame (frames[i].data, frames[i].size);
+
+        wakeWriter = (frontCount == CAPTURE_WAKE_RECORDS);
+    }
+
+    if (wakeWriter)
+        blockReady.notify_one();
+}
+
+void CaptureWriter::run()
+{
+    std::unique_lock<std::mutex> sl (lock);
+
+    while (true)
+    {
+        blockReady.wait_for (sl, std::chrono::milliseconds (CAPTURE_FLUSH_MS),
+                             [this] { return shouldExit || frontCount >= CAPTURE_WAKE_RECORDS; });
+
+        // swap blocks so recording carries on while the full one is written
+        const int backBlock = frontBlock;
+        const int backCount = frontCount;
+        const bool exiting = shouldExit;
+
+        frontBlock = 1 - frontBlock;
+        frontCount = 0;
+
+        sl.unlock();
+        writeBlock (blocks[backBlock], backCount);
+        sl.lock();
+
+        if (exiting)
+            break;
+    }
+}
+
+void CaptureWriter::writeBlock (std::vector<CaptureRecord>& block, int count)
+{
+    if (count == 0)
+        return;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (! google::protobuf::util::SerializeDelimitedToZeroCopyStream (block[i], file.get()))
+        {
+            std::cout << "Failed to write capture file " << path << std::endl;
+            droppedCount += uint64_t (count - i);
+            break;
+        }
+
+        recordCount++;
+
+        for (int f = 0; f < block[i].numFrames; f++)
+        {
+            if (block[i].frames[f].capacity() > MAX_RETAINED_FRAME_SIZE)
+                std::string().swap (block[i].frames[f]);
+        }
+    }
+
+    // a crash loses at most one block
+    file->Flush();
+    bytesWritten = uint64_t (file->ByteCount());
+}
+
+/*********************************************/
+CaptureReader::CaptureReader()
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::open (const std::string& path)
+{
+    close();
+
+    const int fd = OPEN_FILE (path.c_str(), O_RDONLY | CAPTURE_OPEN_FLAGS);
+
+    if (fd < 0)
+    {
+        std::cout << "Could not open capture file " << path << std::endl;
+        return false;
+    }
+
+    file.reset (new google::protobuf::io::FileInputStream (fd));
+    file->SetCloseOnDelete (true);
+
+    return true;
+}
+
+void CaptureReader::close()
+{
+    file.reset();
+}
+
+bool CaptureReader::next (CaptureRecord& record)
+{
+    if (file == nullptr)
+        return false;
+
+    record.Clear();
+
+    bool cleanEof = false;
+
+    if (google::protobuf::util::ParseDelimitedFromZeroCopyStream (&record, file.get(), &cleanEof))
+        return true;
+
+    if (! cleanEof)
+        std::cout << "Capture file ends with a damaged record" << std::endl;
+
+    return false;
+}
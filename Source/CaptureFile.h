@@ -0,0 +1,199 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CAPTUREFILE_H_47D1C8B9__
+#define __CAPTUREFILE_H_47D1C8B9__
+
+#include <google/protobuf/message_lite.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ One ZMQ message in a capture file.
+
+ Written with the protobuf delimited format, so a capture is a sequence of
+ varint-length-prefixed records with this schema:
+
+    message capture_record {
+        optional int64 timestamp_nanos = 1;   // ArrivalClock::nowNanos()
+        optional uint32 direction = 2;        // 0 received, 1 sent
+        optional uint32 endpoint = 3;         // index into the plugin's endpoints
+        repeated bytes frames = 4;            // every frame, including ROUTER peer ids
+    }
+
+ Hand-written rather than generated so that its frame buffers can be reused
+ from record to record.
+*/
+class CaptureRecord : public google::protobuf::MessageLite
+{
+public:
+
+    enum Direction
+    {
+        RECEIVED = 0,
+        SENT = 1
+    };
+
+    /** Constructor */
+    CaptureRecord();
+
+    int64_t timestampNanos;
+    uint32_t direction;
+    uint32_t endpoint;
+
+    /** Frames in use; frames past this keep their storage for the next record */
+    int numFrames;
+    std::vector<std::string> frames;
+
+    /** Copy a frame into the next slot */
+    void addFrame (const void* data, size_t size);
+
+    // MessageLite
+    std::string GetTypeName() const override { return "capture_record"; }
+    CaptureRecord* New() const override { return new CaptureRecord(); }
+    void Clear() override;
+    bool IsInitialized() const override { return true; }
+    void CheckTypeAndMergeFrom (const google::protobuf::MessageLite& other) override;
+    bool MergePartialFromCodedStream (google::protobuf::io::CodedInputStream* input) override;
+    size_t ByteSizeLong() const override;
+    void SerializeWithCachedSizes (google::protobuf::io::CodedOutputStream* output) const override;
+    int GetCachedSize() const override { return cachedSize; }
+
+private:
+
+    mutable int cachedSize;
+};
+
+/** A frame to capture, pointing into the caller's buffer */
+struct CaptureFrame
+{
+    const void* data;
+    size_t size;
+};
+
+/**
+ Records messages to a capture file without stalling the thread that sends or receives them.
+
+ record() copies frames into the front block under a short lock. A writer
+ thread swaps the blocks and serializes the back one to the file with
+ SerializeDelimitedToZeroCopyStream, so file I/O never happens on the
+ recording thread. If the writer falls a whole block behind, new records
+ are dropped and counted instead of waiting.
+*/
+class CaptureWriter
+{
+public:
+
+    /** Constructor */
+    CaptureWriter();
+
+    /** Destructor */
+    ~CaptureWriter();
+
+    /** Start capturing to a new file; returns false if it couldn't be created */
+    bool open (const std::string& path);
+
+    /** Write what is buffered and close the file */
+    void close();
+
+    bool isOpen() const { return active; }
+
+    const std::string& getPath() const { return path; }
+
+    /** Record a message (any thread) */
+    void record (CaptureRecord::Direction direction, uint32_t endpoint, int64_t timestampNanos,
+                 const CaptureFrame* frames, int numFrames);
+
+    uint64_t getRecordCount() const { return recordCount; }
+    uint64_t getDroppedCount() const { return droppedCount; }
+    uint64_t getBytesWritten() const { return bytesWritten; }
+
+private:
+
+    void run();
+
+    /** Serialize and write one block (writer thread) */
+    void writeBlock (std::vector<CaptureRecord>& block, int count);
+
+    std::string path;
+    std::unique_ptr<google::protobuf::io::FileOutputStream> file;
+
+    std::vector<CaptureRecord> blocks[2];
+    int frontBlock;
+    int frontCount;
+
+    std::mutex lock;
+    std::condition_variable blockReady;
+
+    std::thread thread;
+    std::atomic<bool> active;
+    bool shouldExit;
+
+    std::atomic<uint64_t> recordCount;
+    std::atomic<uint64_t> droppedCount;
+    std::atomic<uint64_t> bytesWritten;
+
+    CaptureWriter (const CaptureWriter&) = delete;
+    CaptureWriter& operator= (const CaptureWriter&) = delete;
+};
+
+/**
+ Reads the records of a capture file back in order.
+*/
+class CaptureReader
+{
+public:
+
+    /** Constructor */
+    CaptureReader();
+
+    /** Destructor */
+    ~CaptureReader();
+
+    /** Open a capture file; returns false if it can't be read */
+    bool open (const std::string& path);
+
+    void close();
+
+    bool isOpen() const { return file != nullptr; }
+
+    /** Read the next record; returns false at the end of the file or on a damaged record */
+    bool next (CaptureRecord& record);
+
+private:
+
+    std::unique_ptr<google::protobuf::io::FileInputStream> file;
+
+    CaptureReader (const CaptureReader&) = delete;
+    CaptureReader& operator= (const CaptureReader&) = delete;
+};
+
+#endif  // __CAPTUREFILE_H_47D1C8B9__
@@ -0,0 +1,169 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CommandExecutor.h"
+#include "ArrivalClock.h"
+
+CommandExecutor::CommandExecutor (int numWorkers, Function wakeOwner_)
+    : wakeOwner             (wakeOwner_)
+    , shouldExit            (false)
+    , maxQueueDelayNanos    (0)
+    , submittedCount        (0)
+    , completedCount        (0)
+{
+    for (int i = 0; i < (numWorkers > 0 ? numWorkers : 1); i++)
+    {
+        workers.emplace_back (new Worker());
+        workers.back()->busy = false;
+    }
+
+    for (auto& worker : workers)
+    {
+        Worker* w = worker.get();
+        w->thread = std::thread ([this, w] { run (*w); });
+    }
+}
+
+CommandExecutor::~CommandExecutor()
+{
+    waitUntilIdle();
+
+    {
+        std::lock_guard<std::mutex> sl (lock);
+        shouldExit = true;
+    }
+
+    workAvailable.notify_all();
+
+    for (auto& worker : workers)
+        worker->thread.join();
+}
+
+void CommandExecutor::submit (const std::string& client, Function work, Function completion)
+{
+    Task task;
+    task.client = client;
+    task.work = std::move (work);
+    task.completion = std::move (completion);
+    task.submitNanos = ArrivalClock::nowNanos();
+
+    pendingByClient[client]++;
+    submittedCount++;
+
+    {
+        std::lock_guard<std::mutex> sl (lock);
+
+        const size_t index = std::hash<std::string>() (client) % workers.size();
+        workers[index]->queue.push_back (std::move (task));
+    }
+
+    workAvailable.notify_all();
+}
+
+bool CommandExecutor::isBusy (const std::string& client) const
+{
+    auto it = pendingByClient.find (client);
+    return it != pendingByClient.end() && it->second > 0;
+}
+
+int CommandExecutor::runCompletions()
+{
+    {
+        std::lock_guard<std::mutex> sl (lock);
+
+        if (finished.empty())
+            return 0;
+
+        completing.swap (finished);
+    }
+
+    for (Task& task : completing)
+    {
+        if (task.completion)
+            task.completion();
+
+        if (--pendingByClient[task.client] <= 0)
+            pendingByClient.erase (task.client);
+
+        completedCount++;
+    }
+
+    const int numRun = int (completing.size());
+    completing.clear();
+
+    return numRun;
+}
+
+void CommandExecutor::waitUntilIdle()
+{
+    std::unique_lock<std::mutex> sl (lock);
+
+    idle.wait (sl, [this]
+    {
+        for (auto& worker : workers)
+        {
+            if (worker->busy || ! worker->queue.empty())
+                return false;
+        }
+
+        return true;
+    });
+}
+
+void CommandExecutor::run (Worker& worker)
+{
+    std::unique_lock<std::mutex> sl (lock);
+
+    while (true)
+    {
+        workAvailable.wait (sl, [this, &worker] { return shouldExit || ! worker.queue.empty(); });
+
+        if (worker.queue.empty())
+            break;
+
+        Task task = std::move (worker.queue.front());
+        worker.queue.pop_front();
+        worker.busy = true;
+
+        sl.unlock();
+
+        const int64_t delay = ArrivalClock::nowNanos() - task.submitNanos;
+        queueDelay.add (delay);
+
+        int64_t previous = maxQueueDelayNanos;
+        while (delay > previous && ! maxQueueDelayNanos.compare_exchange_weak (previous, delay)) { }
+
+        if (task.work)
+            task.work();
+
+        sl.lock();
+
+        finished.push_back (std::move (task));
+        worker.busy = false;
+
+        sl.unlock();
+        wakeOwner();
+        idle.notify_all();
+        sl.lock();
+    }
+}
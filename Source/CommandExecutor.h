@@ -0,0 +1,129 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __COMMANDEXECUTOR_H_8C3B5F14__
+#define __COMMANDEXECUTOR_H_8C3B5F14__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PluginMetrics.h"
+
+/**
+ Runs slow commands on worker threads so the I/O thread keeps answering cheap queries.
+
+ Each task has work, run on a worker, and a completion, run later on the owning
+ thread when it calls runCompletions(). All tasks from one client go to the same
+ worker, so they run and complete in the order they were submitted. A completion-only
+ task for a busy client waits its turn, which keeps cheap commands in order behind
+ slow ones from the same client.
+
+ submit(), isBusy() and runCompletions() are for the owning thread only.
+*/
+class CommandExecutor
+{
+public:
+
+    typedef std::function<void()> Function;
+
+    /** Constructor. wakeOwner is called from a worker when completions are waiting. */
+    CommandExecutor (int numWorkers, Function wakeOwner);
+
+    /** Destructor: finishes queued work; completions that haven't run are discarded */
+    ~CommandExecutor();
+
+    /** Queue a task for the client; work may be empty */
+    void submit (const std::string& client, Function work, Function completion);
+
+    /** True if the client has tasks whose completion hasn't run yet */
+    bool isBusy (const std::string& client) const;
+
+    /** True if any client has */
+    bool isBusy() const { return ! pendingByClient.empty(); }
+
+    /** Run the completions of finished tasks, in order. Returns the number run. */
+    int runCompletions();
+
+    /** Wait until every queued task's work is done */
+    void waitUntilIdle();
+
+    /** Time from submit() until a worker picked the task up */
+    const LatencyHistogram& getQueueDelay() const { return queueDelay; }
+    int64_t getMaxQueueDelayNanos() const { return maxQueueDelayNanos; }
+
+    uint64_t getSubmittedCount() const { return submittedCount; }
+    uint64_t getCompletedCount() const { return completedCount; }
+
+private:
+
+    struct Task
+    {
+        std::string client;
+        Function work;
+        Function completion;
+        int64_t submitNanos;
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        std::deque<Task> queue;
+        bool busy;
+    };
+
+    void run (Worker& worker);
+
+    Function wakeOwner;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex lock;
+    std::condition_variable workAvailable;
+    std::condition_variable idle;
+    bool shouldExit;
+
+    /** Finished tasks waiting for runCompletions() */
+    std::vector<Task> finished;
+    std::vector<Task> completing;
+
+    /** Tasks per client that haven't completed yet (owner thread) */
+    std::map<std::string, int> pendingByClient;
+
+    LatencyHistogram queueDelay;
+    std::atomic<int64_t> maxQueueDelayNanos;
+    std::atomic<uint64_t> submittedCount;
+    std::atomic<uint64_t> completedCount;
+
+    CommandExecutor (const CommandExecutor&) = delete;
+    CommandExecutor& operator= (const CommandExecutor&) = delete;
+};
+
+#endif  // __COMMANDEXECUTOR_H_8C3B5F14__
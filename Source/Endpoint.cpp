@@ -0,0 +1,355 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Endpoint.h"
+#include "ArrivalClock.h"
+#include "CaptureFile.h"
+#include "WakeupChannel.h"
+
+#include <iostream>
+
+EndpointConfig::EndpointConfig()
+    : type (ZMQ_ROUTER)
+    , bind (false)
+{
+}
+
+int EndpointConfig::socketTypeFromName (const std::string& name)
+{
+    if (name == "ROUTER") return ZMQ_ROUTER;
+    if (name == "DEALER") return ZMQ_DEALER;
+    if (name == "SUB")    return ZMQ_SUB;
+    if (name == "PUB")    return ZMQ_PUB;
+
+    return -1;
+}
+
+std::string EndpointConfig::socketTypeName (int type)
+{
+    switch (type)
+    {
+        case ZMQ_ROUTER: return "ROUTER";
+        case ZMQ_DEALER: return "DEALER";
+        case ZMQ_SUB:    return "SUB";
+        case ZMQ_PUB:    return "PUB";
+        default:         return "UNKNOWN";
+    }
+}
+
+Endpoint::Endpoint (const EndpointConfig& config_, int sendQueueCapacity)
+    : config            (config_)
+    , socket            (nullptr)
+    , context           (nullptr)
+    , sendHighWaterMark (0)
+    , outbound          (sendQueueCapacity)
+    , failed            (false)
+    , acceptedHandlers  (~uint64_t (0))
+    , receivedCount     (0)
+    , rejectedCount     (0)
+    , capture           (nullptr)
+    , captureIndex      (0)
+{
+    for (int i = 0; i <= MAX_FRAMES; i++)
+        zmq_msg_init (&frames[i]);
+}
+
+Endpoint::~Endpoint()
+{
+    close();
+
+    for (int i = 0; i <= MAX_FRAMES; i++)
+        zmq_msg_close (&frames[i]);
+}
+
+bool Endpoint::open (void* context_, const std::string& identity_, int sendHighWaterMark_)
+{
+    context = context_;
+    identity = identity_;
+    sendHighWaterMark = sendHighWaterMark_;
+
+    // messages queued while the socket was closed are kept and sent once connected;
+    // with no linger, closing also throws away any half-sent message
+    if (socket != nullptr)
+        zmq_close (socket);
+
+    outbound.socketReplaced();
+
+    socket = zmq_socket (context, config.type);
+
+    int lingervalue = 0;
+
+    zmq_setsockopt (socket, ZMQ_LINGER, &lingervalue, sizeof lingervalue);
+    zmq_setsockopt (socket, ZMQ_SNDHWM, &sendHighWaterMark, sizeof sendHighWaterMark);
+
+    if (config.type == ZMQ_ROUTER || config.type == ZMQ_DEALER)
+        zmq_setsockopt (socket, ZMQ_IDENTITY, identity.c_str(), identity.length());
+
+    if (config.type == ZMQ_ROUTER)
+    {
+        int probe_router = 1;
+        int mandatory = 1; // report EAGAIN at the high-water mark instead of silently dropping
+
+        zmq_setsockopt (socket, ZMQ_PROBE_ROUTER, &probe_router, sizeof probe_router);
+        zmq_setsockopt (socket, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof mandatory);
+    }
+    else if (config.type == ZMQ_SUB)
+    {
+        // the topic is the message_id frame
+        if (config.messageIds.empty())
+            zmq_setsockopt (socket, ZMQ_SUBSCRIBE, "", 0);
+
+        for (const std::string& id : config.messageIds)
+            zmq_setsockopt (socket, ZMQ_SUBSCRIBE, id.c_str(), id.length());
+    }
+
+    std::cout << (config.bind ? "Binding " : "Connecting ") << config.name << " ("
+              << EndpointConfig::socketTypeName (config.type) << ") to " << config.url << std::endl;
+
+    const int rc = config.bind ? zmq_bind (socket, config.url.c_str())
+                               : zmq_connect (socket, config.url.c_str());
+
+    if (rc != 0)
+    {
+        std::cout << "Failed to open socket: " << zmq_strerror (zmq_errno()) << std::endl;
+        zmq_close (socket);
+        socket = nullptr;
+
+        // a socket that will never flush mustn't collect messages
+        failed = true;
+        outbound.clear();
+        return false;
+    }
+
+    failed = false;
+    return true;
+}
+
+void Endpoint::close()
+{
+    if (socket != nullptr)
+    {
+        zmq_close (socket);
+        socket = nullptr;
+    }
+
+    outbound.clear();
+}
+
+int Endpoint::flush()
+{
+    if (socket == nullptr)
+        return 0;
+
+    const int numSent = outbound.flush (socket);
+
+    if (outbound.hasUnfinishedMessage())
+    {
+        std::cout << "Reopening " << config.name << " to discard a partly sent message" << std::endl;
+        open (context, identity, sendHighWaterMark);
+    }
+
+    return numSent;
+}
+
+int Endpoint::receive (const MessageCallback& callback, int maxMessages)
+{
+    // ROUTER sockets prefix every message with the sending peer's identity
+    const int idFrame = config.type == ZMQ_ROUTER ? 1 : 0;
+    const int numExpected = idFrame + 2;
+
+    int numReceived = 0;
+
+    while (numReceived < maxMessages)
+    {
+        // wait only for the first frame; the rest of a multipart message arrives with it
+        if (zmq_msg_recv (&frames[0], socket, ZMQ_DONTWAIT) < 0)
+        {
+            if (zmq_errno() != EAGAIN)
+                std::cout << "Failed to receive message: " << zmq_strerror (zmq_errno()) << std::endl;
+
+            break;
+        }
+
+        const int64_t arrivalNanos = ArrivalClock::nowNanos();
+        int numFrames = 1;
+        bool more = zmq_msg_more (&frames[0]) != 0;
+
+        while (more)
+        {
+            // frames past the payload are read into the scratch frame and discarded
+            zmq_msg_t* frame = &frames[numFrames < numExpected ? numFrames : MAX_FRAMES];
+
+            if (zmq_msg_recv (frame, socket, 0) < 0)
+                break;
+
+            if (numFrames < numExpected)
+                numFrames++;
+
+            more = zmq_msg_more (frame) != 0;
+        }
+
+        numReceived++;
+        receivedCount++;
+
+        if (capture != nullptr && capture->isOpen())
+        {
+            CaptureFrame captured[MAX_FRAMES];
+
+            for (int i = 0; i < numFrames; i++)
+                captured[i] = { zmq_msg_data (&frames[i]), zmq_msg_size (&frames[i]) };
+
+            capture->record (CaptureRecord::RECEIVED, captureIndex, arrivalNanos, captured, numFrames);
+        }
+
+        // probe and other short messages carry no payload
+        if (numFrames < numExpected)
+            continue;
+
+        if (config.type == ZMQ_ROUTER)
+            currentPeer.assign (static_cast<const char*> (zmq_msg_data (&frames[0])), zmq_msg_size (&frames[0]));
+
+        callback (static_cast<const char*> (zmq_msg_data (&frames[idFrame])), zmq_msg_size (&frames[idFrame]),
+                  zmq_msg_data (&frames[idFrame + 1]), zmq_msg_size (&frames[idFrame + 1]),
+                  arrivalNanos);
+    }
+
+    return numReceived;
+}
+
+bool Endpoint::send (const std::string& peer, const std::string& messageId, const std::string& payload)
+{
+    if (failed)
+        return false;
+
+    const std::string* parts[] = { &peer, &messageId, &payload };
+
+    // only ROUTER sockets address a peer
+    const int first = config.type == ZMQ_ROUTER ? 0 : 1;
+
+    if (capture != nullptr && capture->isOpen())
+    {
+        CaptureFrame captured[3];
+
+        for (int i = first; i < 3; i++)
+            captured[i - first] = { parts[i]->data(), parts[i]->length() };
+
+        capture->record (CaptureRecord::SENT, captureIndex, ArrivalClock::nowNanos(), captured, 3 - first);
+    }
+
+    return outbound.push (parts + first, 3 - first);
+}
+
+bool Endpoint::routes (const std::string& messageId) const
+{
+    if (config.messageIds.empty())
+        return true;
+
+    for (const std::string& id : config.messageIds)
+    {
+        if (id == messageId)
+            return true;
+    }
+
+    return false;
+}
+
+bool Endpoint::accepts (int handlerIndex) const
+{
+    if (handlerIndex < 0 || handlerIndex >= 64)
+        return true;
+
+    return (acceptedHandlers & (uint64_t (1) << handlerIndex)) != 0;
+}
+
+EndpointPoller::EndpointPoller()
+    : wakeup (nullptr)
+{
+}
+
+void EndpointPoller::build (const std::vector<Endpoint*>& endpoints_, WakeupChannel* wakeup_)
+{
+    endpoints = endpoints_;
+    wakeup = wakeup_;
+
+    items.reserve (endpoints.size() + 1);
+    itemEndpoint.reserve (endpoints.size() + 1);
+    filledSockets.resize (endpoints.size());
+
+    fill();
+}
+
+void EndpointPoller::fill()
+{
+    items.clear();
+    itemEndpoint.clear();
+
+    for (int i = 0; i < int (endpoints.size()); i++)
+    {
+        filledSockets[i] = endpoints[i]->getSocket();
+
+        // endpoints that failed to open have no socket
+        if (filledSockets[i] == nullptr || ! endpoints[i]->canReceive())
+            continue;
+
+        zmq_pollitem_t item = { filledSockets[i], 0, ZMQ_POLLIN, 0 };
+        items.push_back (item);
+        itemEndpoint.push_back (i);
+    }
+
+    if (wakeup != nullptr && wakeup->getSocket() != nullptr)
+    {
+        zmq_pollitem_t item = { wakeup->getSocket(), 0, ZMQ_POLLIN, 0 };
+        items.push_back (item);
+        itemEndpoint.push_back (-1);
+    }
+}
+
+int EndpointPoller::poll (int timeoutMs, std::vector<int>& ready)
+{
+    for (size_t i = 0; i < endpoints.size(); i++)
+    {
+        if (endpoints[i]->getSocket() != filledSockets[i])
+        {
+            fill();
+            break;
+        }
+    }
+
+    ready.clear();
+
+    if (items.empty() || zmq_poll (items.data(), int (items.size()), timeoutMs) <= 0)
+        return 0;
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if ((items[i].revents & ZMQ_POLLIN) == 0)
+            continue;
+
+        if (itemEndpoint[i] < 0)
+            wakeup->drain();
+        else
+            ready.push_back (itemEndpoint[i]);
+    }
+
+    return int (ready.size());
+}
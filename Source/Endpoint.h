@@ -0,0 +1,211 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __ENDPOINT_H_A81F3E60__
+#define __ENDPOINT_H_A81F3E60__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "OutboundQueue.h"
+#include "resources/zmq.h"
+
+class CaptureWriter;
+class WakeupChannel;
+
+/**
+ Settings for one ZMQ endpoint, as saved in the plugin's XML.
+*/
+struct EndpointConfig
+{
+    EndpointConfig();
+
+    /** Socket type name ("ROUTER", "DEALER", "SUB" or "PUB") to ZMQ socket type; -1 if unknown */
+    static int socketTypeFromName (const std::string& name);
+    static std::string socketTypeName (int type);
+
+    std::string name;
+    int type;
+    std::string url;
+
+    /** Bind instead of connecting (usually for PUB) */
+    bool bind;
+
+    /** Message ids received from (or, for PUB, published to) this endpoint; empty for all */
+    std::vector<std::string> messageIds;
+};
+
+/**
+ One ZMQ socket serviced by the plugin's I/O thread.
+
+ ROUTER endpoints exchange [peer, message_id, payload] messages with the AIBS
+ middleware router; DEALER and SUB endpoints receive [message_id, payload]; PUB
+ endpoints only send [message_id, payload]. Frames are passed to a callback
+ straight out of ZMQ's buffers. Each endpoint has its own send queue and
+ counters. Owned by a single I/O thread apart from the send queue and counters.
+ Deliberately free of JUCE so the benchmark can drive the same code outside
+ the GUI.
+*/
+class Endpoint
+{
+public:
+
+    /** Called for each complete message; pointers are valid only during the call */
+    typedef std::function<void (const char* messageId, size_t idLength,
+                                const void* payload, size_t size,
+                                int64_t arrivalNanos)> MessageCallback;
+
+    /** Constructor */
+    Endpoint (const EndpointConfig& config, int sendQueueCapacity);
+
+    /** Destructor */
+    ~Endpoint();
+
+    /** Create the socket and connect or bind it; returns false if that failed.
+        Messages queued before opening are kept; after a failure nothing more is queued
+        until an open() succeeds. */
+    bool open (void* context, const std::string& identity, int sendHighWaterMark);
+
+    /** Close the socket and discard unsent messages */
+    void close();
+
+    /** The underlying ZMQ socket, or nullptr if closed */
+    void* getSocket() const { return socket; }
+
+    /** True if the last open() failed. Any thread. */
+    bool hasFailed() const { return failed; }
+
+    const EndpointConfig& getConfig() const { return config; }
+
+    /** True for socket types that receive */
+    bool canReceive() const { return config.type != ZMQ_PUB; }
+
+    /** Receive every message that is already queued, up to maxMessages. Returns the number received. */
+    int receive (const MessageCallback& callback, int maxMessages = 1000);
+
+    /** Queue a message; peer is used by ROUTER endpoints only. Returns false if the
+        queue is full or the endpoint failed to open. Any thread. */
+    bool send (const std::string& peer, const std::string& messageId, const std::string& payload);
+
+    /** Send queued messages without blocking (I/O thread). A message that failed part way
+        through leaves its frames in the socket, so the socket is then reopened. */
+    int flush();
+
+    /** True if the endpoint publishes or receives the given id */
+    bool routes (const std::string& messageId) const;
+
+    /** Bit n set if messages for dispatcher handler n are accepted */
+    void setAcceptedHandlers (uint64_t mask) { acceptedHandlers = mask; }
+    bool accepts (int handlerIndex) const;
+
+    /** Record every frame sent and received to a capture, under this endpoint's index */
+    void setCapture (CaptureWriter* writer, uint32_t index) { capture = writer; captureIndex = index; }
+
+    /** Peer that sent the message currently being handled (ROUTER only) */
+    const std::string& getCurrentPeer() const { return currentPeer; }
+
+    const OutboundQueue& getSendQueue() const { return outbound; }
+
+    uint64_t getReceivedCount() const { return receivedCount; }
+    uint64_t getRejectedCount() const { return rejectedCount; }
+
+    /** Note that a message was ignored because the endpoint doesn't route it */
+    void countRejected() { rejectedCount++; }
+
+private:
+
+    EndpointConfig config;
+    void* socket;
+
+    // what the socket was last opened with, for reopening it
+    void* context;
+    std::string identity;
+    int sendHighWaterMark;
+
+    OutboundQueue outbound;
+
+    std::atomic<bool> failed;
+    std::atomic<uint64_t> acceptedHandlers;
+    std::atomic<uint64_t> receivedCount;
+    std::atomic<uint64_t> rejectedCount;
+
+    std::string currentPeer;
+
+    CaptureWriter* capture;
+    uint32_t captureIndex;
+
+    // peer, message_id and payload, plus one scratch frame for anything after the payload
+    static const int MAX_FRAMES = 3;
+    zmq_msg_t frames[MAX_FRAMES + 1];
+
+    Endpoint (const Endpoint&) = delete;
+    Endpoint& operator= (const Endpoint&) = delete;
+};
+
+/**
+ The I/O thread's poll set: every receiving endpoint with an open socket, plus
+ the wakeup channel.
+
+ Built once when the endpoints have been opened and reused for every poll. An
+ endpoint that is reopened later has a new socket; poll() notices and refills
+ the set in its existing storage, so polling never allocates.
+*/
+class EndpointPoller
+{
+public:
+
+    /** Constructor */
+    EndpointPoller();
+
+    /** Poll these endpoints, identified by their index in the vector, and the wakeup channel if not nullptr */
+    void build (const std::vector<Endpoint*>& endpoints, WakeupChannel* wakeup);
+
+    /** Wait up to timeoutMs (-1 for no limit) for any endpoint to have a message, or a wakeup.
+        Pending wakeups are drained. Returns the number of endpoints with messages; their
+        indices are written to ready. */
+    int poll (int timeoutMs, std::vector<int>& ready);
+
+private:
+
+    /** Rebuild items from the endpoints' current sockets */
+    void fill();
+
+    std::vector<Endpoint*> endpoints;
+    WakeupChannel* wakeup;
+
+    std::vector<zmq_pollitem_t> items;
+
+    // endpoint index of each item, -1 for the wakeup channel
+    std::vector<int> itemEndpoint;
+
+    // each endpoint's socket as of the last fill()
+    std::vector<void*> filledSockets;
+
+    EndpointPoller (const EndpointPoller&) = delete;
+    EndpointPoller& operator= (const EndpointPoller&) = delete;
+};
+
+#endif  // __ENDPOINT_H_A81F3E60__
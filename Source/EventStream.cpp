@@ -0,0 +1,357 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "EventStream.h"
+#include "ArrivalClock.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <algorithm>
+#include <iostream>
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+/** Records per event_batch message; a longer backlog goes out as several */
+const int MAX_BATCH_RECORDS = 1024;
+
+/** How long the publishing thread sleeps between checks for stop() */
+const int IDLE_POLL_MS = 100;
+
+namespace
+{
+    size_t varintSize (int64_t value)  { return CodedOutputStream::VarintSize64 (uint64_t (value)); }
+    size_t varintSize (uint32_t value) { return CodedOutputStream::VarintSize32 (value); }
+
+    template <typename T>
+    size_t packedSize (const std::vector<T>& values)
+    {
+        size_t size = 0;
+
+        for (const T& value : values)
+            size += varintSize (value);
+
+        return size;
+    }
+
+    void writeVarint (CodedOutputStream& out, int64_t value)  { out.WriteVarint64 (uint64_t (value)); }
+    void writeVarint (CodedOutputStream& out, uint32_t value) { out.WriteVarint32 (value); }
+
+    template <typename T>
+    void writePacked (CodedOutputStream& out, int field, const std::vector<T>& values)
+    {
+        if (values.empty())
+            return;
+
+        out.WriteTag (WireFormatLite::MakeTag (field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+        out.WriteVarint32 (uint32_t (packedSize (values)));
+
+        for (const T& value : values)
+            writeVarint (out, value);
+    }
+
+    void writePacked (CodedOutputStream& out, int field, const std::vector<bool>& values)
+    {
+        if (values.empty())
+            return;
+
+        out.WriteTag (WireFormatLite::MakeTag (field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+        out.WriteVarint32 (uint32_t (values.size()));
+
+        for (bool value : values)
+            out.WriteVarint32 (value ? 1 : 0);
+    }
+
+    size_t snippetSize (const StreamRecord& snippet)
+    {
+        const size_t samplesSize = sizeof (float) * size_t (snippet.numSamples);
+
+        return 1 + CodedOutputStream::VarintSize32 (snippet.channel)
+             + 1 + CodedOutputStream::VarintSize64 (uint64_t (snippet.sampleNumber))
+             + 1 + CodedOutputStream::VarintSize32 (snippet.value)
+             + 1 + CodedOutputStream::VarintSize32 (uint32_t (samplesSize)) + samplesSize;
+    }
+}
+
+EventStream::EventStream (int ringCapacity)
+    : ring          (ringCapacity)
+    , pendingWake   (false)
+    , context       (nullptr)
+    , running       (false)
+    , shouldExit    (false)
+    , batchCount    (0)
+    , recordCount   (0)
+    , droppedCount  (0)
+{
+}
+
+EventStream::~EventStream()
+{
+    stop();
+}
+
+bool EventStream::start (void* context_, const std::string& url_)
+{
+    stop();
+
+    context = context_;
+    url = url_;
+
+    EndpointConfig config;
+    config.name = "event_stream";
+    config.type = ZMQ_PUB;
+    config.url = url;
+    config.bind = true;
+
+    publisher.reset (new Endpoint (config, MAX_BATCH_RECORDS));
+
+    if (! wakeup.open (context, "protobuf-stream-" + std::to_string (reinterpret_cast<uintptr_t> (this))))
+        return false;
+
+    shouldExit = false;
+    running = true;
+    thread = std::thread ([this] { run(); });
+
+    return true;
+}
+
+void EventStream::stop()
+{
+    if (thread.joinable())
+    {
+        shouldExit = true;
+        wakeup.wake();
+        thread.join();
+    }
+
+    running = false;
+    wakeup.close();
+    publisher.reset();
+
+    // anything left belongs to a stream nobody is listening to any more
+    while (ring.front() != nullptr)
+        ring.popFront();
+}
+
+void EventStream::addTtl (int64_t sampleNumber, uint32_t channel, uint32_t line, bool state)
+{
+    StreamRecord* record = ring.beginPush();
+
+    if (record == nullptr)
+    {
+        droppedCount++;
+        return;
+    }
+
+    record->kind = StreamRecord::TTL;
+    record->sampleNumber = sampleNumber;
+    record->channel = channel;
+    record->value = line;
+    record->state = state;
+    record->numSamples = 0;
+
+    ring.commitPush();
+    pendingWake = true;
+}
+
+void EventStream::addSpike (int64_t sampleNumber, uint32_t electrode, uint32_t sortedId)
+{
+    StreamRecord* record = ring.beginPush();
+
+    if (record == nullptr)
+    {
+        droppedCount++;
+        return;
+    }
+
+    record->kind = StreamRecord::SPIKE;
+    record->sampleNumber = sampleNumber;
+    record->channel = electrode;
+    record->value = sortedId;
+    record->state = false;
+    record->numSamples = 0;
+
+    ring.commitPush();
+    pendingWake = true;
+}
+
+void EventStream::addSnippet (uint32_t channel, int64_t firstSample, uint32_t step, const float* data, int numValues)
+{
+    // long stretches are split over several records
+    for (int offset = 0; offset < numValues; offset += MAX_SNIPPET_SAMPLES)
+    {
+        StreamRecord* record = ring.beginPush();
+
+        if (record == nullptr)
+        {
+            droppedCount++;
+            return;
+        }
+
+        const int count = std::min (MAX_SNIPPET_SAMPLES, numValues - offset);
+
+        record->kind = StreamRecord::SNIPPET;
+        record->sampleNumber = firstSample + int64_t (offset) * step;
+        record->channel = channel;
+        record->value = step;
+        record->state = false;
+        record->numSamples = count;
+
+        for (int i = 0; i < count; i++)
+            record->samples[i] = data[size_t (offset + i) * step];
+
+        ring.commitPush();
+        pendingWake = true;
+    }
+}
+
+void EventStream::endBlock()
+{
+    if (! pendingWake)
+        return;
+
+    pendingWake = false;
+    wakeup.wake();
+}
+
+void EventStream::run()
+{
+    if (! publisher->open (context, "", 1000))
+    {
+        running = false;
+        return;
+    }
+
+    zmq_pollitem_t item = { wakeup.getSocket(), 0, ZMQ_POLLIN, 0 };
+
+    while (! shouldExit)
+    {
+        if (zmq_poll (&item, 1, IDLE_POLL_MS) > 0)
+            wakeup.drain();
+
+        while (publishBatch())
+            publisher->flush();
+    }
+
+    publisher->close();
+}
+
+bool EventStream::publishBatch()
+{
+    ttlSamples.clear();
+    ttlChannels.clear();
+    ttlLines.clear();
+    ttlStates.clear();
+    spikeSamples.clear();
+    spikeElectrodes.clear();
+    spikeSortedIds.clear();
+    snippets.clear();
+
+    int numRecords = 0;
+    StreamRecord* record;
+
+    while (numRecords < MAX_BATCH_RECORDS && (record = ring.front()) != nullptr)
+    {
+        switch (record->kind)
+        {
+            case StreamRecord::TTL:
+                ttlSamples.push_back (record->sampleNumber);
+                ttlChannels.push_back (record->channel);
+                ttlLines.push_back (record->value);
+                ttlStates.push_back (record->state);
+                break;
+
+            case StreamRecord::SPIKE:
+                spikeSamples.push_back (record->sampleNumber);
+                spikeElectrodes.push_back (record->channel);
+                spikeSortedIds.push_back (record->value);
+                break;
+
+            case StreamRecord::SNIPPET:
+                snippets.push_back (*record);
+                break;
+        }
+
+        ring.popFront();
+        numRecords++;
+    }
+
+    if (numRecords == 0)
+        return false;
+
+    encodeBatch();
+
+    publisher->send ("", "event_batch", payload);
+    batchCount++;
+    recordCount += uint64_t (numRecords);
+
+    return true;
+}
+
+void EventStream::encodeBatch()
+{
+    payload.clear();
+
+    {
+        google::protobuf::io::StringOutputStream stream (&payload);
+        CodedOutputStream out (&stream);
+
+        out.WriteTag (WireFormatLite::MakeTag (1, WireFormatLite::WIRETYPE_VARINT));
+        out.WriteVarint64 (batchCount);
+        out.WriteTag (WireFormatLite::MakeTag (2, WireFormatLite::WIRETYPE_VARINT));
+        out.WriteVarint64 (uint64_t (ArrivalClock::nowNanos()));
+        out.WriteTag (WireFormatLite::MakeTag (3, WireFormatLite::WIRETYPE_VARINT));
+        out.WriteVarint64 (droppedCount);
+
+        writePacked (out, 4, ttlSamples);
+        writePacked (out, 5, ttlChannels);
+        writePacked (out, 6, ttlLines);
+        writePacked (out, 7, ttlStates);
+        writePacked (out, 8, spikeSamples);
+        writePacked (out, 9, spikeElectrodes);
+        writePacked (out, 10, spikeSortedIds);
+
+        for (const StreamRecord& snippet : snippets)
+        {
+            out.WriteTag (WireFormatLite::MakeTag (11, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+            out.WriteVarint32 (uint32_t (snippetSize (snippet)));
+
+            out.WriteTag (WireFormatLite::MakeTag (1, WireFormatLite::WIRETYPE_VARINT));
+            out.WriteVarint32 (snippet.channel);
+            out.WriteTag (WireFormatLite::MakeTag (2, WireFormatLite::WIRETYPE_VARINT));
+            out.WriteVarint64 (uint64_t (snippet.sampleNumber));
+            out.WriteTag (WireFormatLite::MakeTag (3, WireFormatLite::WIRETYPE_VARINT));
+            out.WriteVarint32 (snippet.value);
+
+            out.WriteTag (WireFormatLite::MakeTag (4, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+            out.WriteVarint32 (uint32_t (sizeof (float) * size_t (snippet.numSamples)));
+
+            for (int i = 0; i < snippet.numSamples; i++)
+                out.WriteLittleEndian32 (WireFormatLite::EncodeFloat (snippet.samples[i]));
+        }
+    }
+
+    // the CodedOutputStream destructor above backed the string up to the bytes written
+}
@@ -0,0 +1,177 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __EVENTSTREAM_H_6B2E94D1__
+#define __EVENTSTREAM_H_6B2E94D1__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Endpoint.h"
+#include "SpscQueue.h"
+#include "WakeupChannel.h"
+
+/** Most continuous samples carried by one StreamRecord */
+const int MAX_SNIPPET_SAMPLES = 64;
+
+/**
+ One TTL event, spike or stretch of downsampled continuous data, waiting in
+ the ring between process() and the publishing thread
+*/
+struct StreamRecord
+{
+    enum Kind
+    {
+        TTL,
+        SPIKE,
+        SNIPPET
+    };
+
+    Kind kind;
+    int64_t sampleNumber;
+
+    /** TTL: event channel; spike: electrode; snippet: continuous channel */
+    uint32_t channel;
+
+    /** TTL: line; spike: sorted id; snippet: samples between values */
+    uint32_t value;
+
+    /** TTL state */
+    bool state;
+
+    int numSamples;
+    float samples[MAX_SNIPPET_SAMPLES];
+};
+
+/**
+ Publishes TTL events, spikes and downsampled continuous data on a ZMQ PUB socket.
+
+ process() adds records to a lock-free ring without blocking or allocating and
+ wakes the publishing thread once per block. That thread drains the ring and
+ sends each batch as an event_batch message, [message_id, payload], so
+ subscribers can filter on the first frame. The payload is protobuf wire
+ format with packed repeated fields:
+
+    message event_batch {
+        optional uint64 sequence = 1;
+        optional int64 publish_nanos = 2;    // ArrivalClock::nowNanos() when sent
+        optional uint64 dropped = 3;         // records lost to a full ring so far
+        repeated int64 ttl_sample = 4 [packed = true];
+        repeated uint32 ttl_channel = 5 [packed = true];
+        repeated uint32 ttl_line = 6 [packed = true];
+        repeated bool ttl_state = 7 [packed = true];
+        repeated int64 spike_sample = 8 [packed = true];
+        repeated uint32 spike_electrode = 9 [packed = true];
+        repeated uint32 spike_sorted_id = 10 [packed = true];
+        repeated snippet continuous = 11;
+    }
+
+    message snippet {
+        optional uint32 channel = 1;
+        optional int64 first_sample = 2;
+        optional uint32 step = 3;
+        repeated float samples = 4 [packed = true];
+    }
+
+ Add functions are for one producer thread only.
+*/
+class EventStream
+{
+public:
+
+    /** Constructor */
+    EventStream (int ringCapacity);
+
+    /** Destructor */
+    ~EventStream();
+
+    /** Bind the PUB socket and start the publishing thread */
+    bool start (void* context, const std::string& url);
+
+    /** Stop the publishing thread and close its sockets */
+    void stop();
+
+    bool isRunning() const { return running; }
+
+    /** Producer: queue a TTL transition */
+    void addTtl (int64_t sampleNumber, uint32_t channel, uint32_t line, bool state);
+
+    /** Producer: queue a spike */
+    void addSpike (int64_t sampleNumber, uint32_t electrode, uint32_t sortedId);
+
+    /** Producer: queue every step-th value of data, which starts at firstSample */
+    void addSnippet (uint32_t channel, int64_t firstSample, uint32_t step, const float* data, int numValues);
+
+    /** Producer: wake the publishing thread if anything was added since the last call */
+    void endBlock();
+
+    uint64_t getBatchCount() const { return batchCount; }
+    uint64_t getRecordCount() const { return recordCount; }
+    uint64_t getDroppedCount() const { return droppedCount; }
+
+private:
+
+    void run();
+
+    /** Drain the ring into one batch and queue it; returns false if the ring was empty */
+    bool publishBatch();
+
+    /** Serialize the collected batch into payload */
+    void encodeBatch();
+
+    SpscQueue<StreamRecord> ring;
+    bool pendingWake;
+
+    void* context;
+    std::string url;
+    std::unique_ptr<Endpoint> publisher;
+    WakeupChannel wakeup;
+
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> shouldExit;
+
+    std::atomic<uint64_t> batchCount;
+    std::atomic<uint64_t> recordCount;
+    std::atomic<uint64_t> droppedCount;
+
+    // reused from batch to batch by the publishing thread
+    std::vector<int64_t> ttlSamples;
+    std::vector<uint32_t> ttlChannels;
+    std::vector<uint32_t> ttlLines;
+    std::vector<bool> ttlStates;
+    std::vector<int64_t> spikeSamples;
+    std::vector<uint32_t> spikeElectrodes;
+    std::vector<uint32_t> spikeSortedIds;
+    std::vector<StreamRecord> snippets;
+    std::string payload;
+
+    EventStream (const EventStream&) = delete;
+    EventStream& operator= (const EventStream&) = delete;
+};
+
+#endif  // __EVENTSTREAM_H_6B2E94D1__
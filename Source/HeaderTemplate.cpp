@@ -0,0 +1,76 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "HeaderTemplate.h"
+
+#include "resources/aibsmw_messages.pb.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+/** Field number of the header in every message that has one */
+const int HEADER_FIELD_NUMBER = 1;
+
+HeaderTemplate::HeaderTemplate()
+{
+    set ("", "");
+}
+
+void HeaderTemplate::set (const std::string& process, const std::string& host)
+{
+    // let the generated code lay out the constant fields
+    message_header header;
+    header.set_process (process);
+    header.set_host (host);
+
+    header.SerializePartialToString (&prefix);
+}
+
+void HeaderTemplate::serialize (const google::protobuf::Message& message, const std::string& messageId,
+                                float timestamp, std::string* output) const
+{
+    const size_t headerSize = prefix.length()
+        + WireFormatLite::TagSize (message_header::kTimestampFieldNumber, WireFormatLite::TYPE_FLOAT)
+        + WireFormatLite::kFloatSize
+        + WireFormatLite::TagSize (message_header::kMessageIdFieldNumber, WireFormatLite::TYPE_STRING)
+        + WireFormatLite::StringSize (messageId);
+
+    output->clear();
+
+    google::protobuf::io::StringOutputStream stream (output);
+    CodedOutputStream out (&stream);
+
+    // fields are written in number order, as the generated serializer does
+    WireFormatLite::WriteTag (HEADER_FIELD_NUMBER, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, &out);
+    out.WriteVarint32 (uint32_t (headerSize));
+    out.WriteRaw (prefix.data(), int (prefix.length()));
+    WireFormatLite::WriteFloat (message_header::kTimestampFieldNumber, timestamp, &out);
+    WireFormatLite::WriteString (message_header::kMessageIdFieldNumber, messageId, &out);
+
+    // the header is unset, so this adds only the message's other fields
+    message.SerializePartialToCodedStream (&out);
+}
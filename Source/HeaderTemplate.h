@@ -0,0 +1,60 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __HEADERTEMPLATE_H_0F7A3D28__
+#define __HEADERTEMPLATE_H_0F7A3D28__
+
+#include <google/protobuf/message.h>
+
+#include <string>
+
+/**
+ Writes the message_header field of outgoing messages from a pre-serialized prefix.
+
+ process and host never change, so they are serialized once. Each message then
+ only adds the timestamp and message_id, followed by the message's own fields.
+ The output is byte-for-byte what the generated serializer produces for a
+ message with its header set.
+*/
+class HeaderTemplate
+{
+public:
+
+    /** Constructor */
+    HeaderTemplate();
+
+    /** Set the constant header fields */
+    void set (const std::string& process, const std::string& host);
+
+    /** Serialize message into output with a header for messageId. The message's
+        own header is expected to be unset; it is written in front instead. */
+    void serialize (const google::protobuf::Message& message, const std::string& messageId,
+                    float timestamp, std::string* output) const;
+
+private:
+
+    /** process and host fields of message_header, in wire format */
+    std::string prefix;
+};
+
+#endif  // __HEADERTEMPLATE_H_0F7A3D28__
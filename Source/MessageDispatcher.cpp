@@ -0,0 +1,129 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "MessageDispatcher.h"
+
+static inline char toLowerAscii (char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char (c + ('a' - 'A')) : c;
+}
+
+MessageDispatcher::MessageDispatcher()
+    : slotMask (0)
+{
+}
+
+void MessageDispatcher::addHandler (const std::string& messageId, google::protobuf::Message* message, Handler handler, bool subscribe)
+{
+    Entry entry;
+    entry.messageId = messageId;
+    entry.message.reset (message);
+    entry.handler = std::move (handler);
+    entry.subscribe = subscribe;
+
+    entries.push_back (std::move (entry));
+
+    rebuildSlots();
+}
+
+void MessageDispatcher::rebuildSlots()
+{
+    // keep the table at most half full so probe sequences stay short
+    size_t numSlots = 8;
+
+    while (numSlots < entries.size() * 2)
+        numSlots *= 2;
+
+    slots.assign (numSlots, -1);
+    slotMask = uint32_t (numSlots - 1);
+
+    for (int i = 0; i < int (entries.size()); i++)
+    {
+        const std::string& id = entries[i].messageId;
+        uint32_t slot = hash (id.data(), id.length()) & slotMask;
+
+        while (slots[slot] != -1)
+            slot = (slot + 1) & slotMask;
+
+        slots[slot] = i;
+    }
+}
+
+int MessageDispatcher::find (const char* messageId, size_t length) const
+{
+    if (slots.empty())
+        return -1;
+
+    uint32_t slot = hash (messageId, length) & slotMask;
+
+    while (slots[slot] != -1)
+    {
+        if (matches (entries[slots[slot]].messageId, messageId, length))
+            return slots[slot];
+
+        slot = (slot + 1) & slotMask;
+    }
+
+    return -1;
+}
+
+bool MessageDispatcher::parse (int handlerIndex, const void* data, size_t size)
+{
+    // missing required fields are tolerated, as they were before the registry existed
+    return entries[handlerIndex].message->ParsePartialFromArray (data, int (size));
+}
+
+void MessageDispatcher::handle (int handlerIndex)
+{
+    Entry& entry = entries[handlerIndex];
+
+    entry.handler (*entry.message);
+}
+
+uint32_t MessageDispatcher::hash (const char* messageId, size_t length)
+{
+    // FNV-1a over the lower-cased id
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= uint8_t (toLowerAscii (messageId[i]));
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+bool MessageDispatcher::matches (const std::string& messageId, const char* other, size_t length)
+{
+    if (messageId.length() != length)
+        return false;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (toLowerAscii (messageId[i]) != toLowerAscii (other[i]))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __MESSAGEDISPATCHER_H_7B2E9D14__
+#define __MESSAGEDISPATCHER_H_7B2E9D14__
+
+#include <google/protobuf/message.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ Maps incoming message ids to handlers in constant time.
+
+ Each handler owns a message instance of its type that is cleared and reused
+ for every message it receives. Ids are matched case-insensitively straight
+ from the received frame, so no string is built per message.
+*/
+class MessageDispatcher
+{
+public:
+
+    /** Constructor */
+    MessageDispatcher();
+
+    /** Register a handler for messages of the given id. Subscribed ids are
+        the ones the router needs a register_for_message for; replies the
+        router sends on its own account are not. */
+    template <class MessageType, class Callback>
+    void add (const std::string& messageId, Callback callback, bool subscribe = true)
+    {
+        addHandler (messageId, new MessageType(),
+                    [callback] (const google::protobuf::Message& m)
+                    {
+                        callback (static_cast<const MessageType&> (m));
+                    },
+                    subscribe);
+    }
+
+    /** Look up the handler for a message id; returns -1 if none is registered */
+    int find (const char* messageId, size_t length) const;
+
+    /** Parse the payload into the handler's message; returns false on malformed input.
+        Kept apart from handle() so the two can be timed separately. */
+    bool parse (int handlerIndex, const void* data, size_t size);
+
+    /** Call the handler with the message parse() filled in */
+    void handle (int handlerIndex);
+
+    /** Number of registered handlers */
+    int getNumHandlers() const { return int (entries.size()); }
+
+    /** Message id of a registered handler */
+    const std::string& getMessageId (int handlerIndex) const { return entries[handlerIndex].messageId; }
+
+    /** True if the handler's message id must be registered with the router */
+    bool isSubscribed (int handlerIndex) const { return entries[handlerIndex].subscribe; }
+
+private:
+
+    typedef std::function<void (const google::protobuf::Message&)> Handler;
+
+    struct Entry
+    {
+        std::string messageId;
+        std::unique_ptr<google::protobuf::Message> message;
+        Handler handler;
+        bool subscribe;
+    };
+
+    void addHandler (const std::string& messageId, google::protobuf::Message* message, Handler handler, bool subscribe);
+
+    /** Rebuild the open-addressing slot table after a handler is added */
+    void rebuildSlots();
+
+    static uint32_t hash (const char* messageId, size_t length);
+    static bool matches (const std::string& messageId, const char* other, size_t length);
+
+    std::vector<Entry> entries;
+    std::vector<int> slots;
+    uint32_t slotMask;
+};
+
+#endif  // __MESSAGEDISPATCHER_H_7B2E9D14__
@@ -0,0 +1,99 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __MESSAGEPOOL_H_E2C95A07__
+#define __MESSAGEPOOL_H_E2C95A07__
+
+#include <google/protobuf/message.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ One reusable instance of each outgoing message type, for the thread that builds replies.
+
+ acquire() hands back the same cleared instance every time. Clearing keeps
+ string and sub-message storage, so once the first few replies have sized it,
+ building a reply doesn't allocate. Each instance must be serialized before the
+ same type is acquired again. Not thread-safe: one pool per thread, though the
+ counters may be read from anywhere.
+*/
+class MessagePool
+{
+public:
+
+    /** Constructor */
+    MessagePool();
+
+    /** Cleared instance of MessageType, created on first use */
+    template <class MessageType>
+    MessageType& acquire()
+    {
+        const size_t index = typeIndex<MessageType>();
+
+        if (index >= messages.size())
+            messages.resize (index + 1);
+
+        if (messages[index] == nullptr)
+        {
+            messages[index].reset (new MessageType());
+            allocationCount++;
+        }
+        else
+        {
+            messages[index]->Clear();
+            reuseCount++;
+        }
+
+        return static_cast<MessageType&> (*messages[index]);
+    }
+
+    /** Messages created because a type was used for the first time */
+    uint64_t getAllocationCount() const { return allocationCount; }
+
+    /** Messages served from the pool */
+    uint64_t getReuseCount() const { return reuseCount; }
+
+private:
+
+    static size_t nextTypeIndex();
+
+    template <class MessageType>
+    static size_t typeIndex()
+    {
+        static const size_t index = nextTypeIndex();
+        return index;
+    }
+
+    std::vector<std::unique_ptr<google::protobuf::Message>> messages;
+
+    std::atomic<uint64_t> allocationCount;
+    std::atomic<uint64_t> reuseCount;
+
+    MessagePool (const MessagePool&) = delete;
+    MessagePool& operator= (const MessagePool&) = delete;
+};
+
+#endif  // __MESSAGEPOOL_H_E2C95A07__
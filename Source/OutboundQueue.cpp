@@ -0,0 +1,219 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "OutboundQueue.h"
+
+#include "resources/zmq.h"
+
+#include <chrono>
+#include <iostream>
+
+/** Buffers bigger than this are released after sending rather than kept for reuse */
+const size_t MAX_RETAINED_PART_SIZE = 1 << 16;
+
+/** How long a message keeps being retried while its ROUTER peer is unreachable */
+const int64_t UNREACHABLE_TIMEOUT_MS = 5000;
+
+static int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds> (
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+OutboundQueue::OutboundQueue (int capacity)
+    : slots         (size_t (capacity > 0 ? capacity : 1))
+    , head          (0)
+    , count         (0)
+    , framesSent    (0)
+    , unfinished    (false)
+    , unreachableSinceMs (-1)
+    , depth         (0)
+    , maxDepth      (0)
+    , sentCount     (0)
+    , droppedCount  (0)
+    , allocationCount (0)
+{
+}
+
+bool OutboundQueue::push (const std::string* const* parts, int numParts)
+{
+    const std::lock_guard<std::mutex> sl (lock);
+
+    if (count >= slots.size())
+    {
+        droppedCount++;
+        return false;
+    }
+
+    OutboundMessage& slot = slots[(head + count) % slots.size()];
+
+    if (slot.parts.capacity() < size_t (numParts))
+        allocationCount++;
+
+    slot.parts.resize (size_t (numParts));
+
+    for (int i = 0; i < numParts; i++)
+    {
+        if (slot.parts[i].capacity() < parts[i]->length())
+            allocationCount++;
+
+        slot.parts[i].assign (*parts[i]);
+    }
+
+    count++;
+    depth = (int) count;
+
+    if (depth > maxDepth)
+        maxDepth = depth.load();
+
+    return true;
+}
+
+int OutboundQueue::flush (void* socket)
+{
+    int numSent = 0;
+
+    // anything sent now would be appended to the frames the socket still holds
+    if (unfinished)
+        return 0;
+
+    while (true)
+    {
+        {
+            const std::lock_guard<std::mutex> sl (lock);
+
+            if (count == 0)
+                break;
+        }
+
+        // Only this thread pops, so the front element stays put while we send it
+        if (! sendFront (socket))
+            break;
+
+        const std::lock_guard<std::mutex> sl (lock);
+
+        // the slot keeps its buffers for the next push, unless they are unusually large
+        for (std::string& part : slots[head].parts)
+        {
+            if (part.capacity() > MAX_RETAINED_PART_SIZE)
+                std::string().swap (part);
+        }
+
+        head = (head + 1) % slots.size();
+        count--;
+        framesSent = 0;
+        unreachableSinceMs = -1;
+        depth = (int) count;
+
+        numSent++;
+
+        if (unfinished)
+            break;
+    }
+
+    return numSent;
+}
+
+bool OutboundQueue::sendFront (void* socket)
+{
+    OutboundMessage* message;
+
+    {
+        const std::lock_guard<std::mutex> sl (lock);
+        message = &slots[head];
+    }
+
+    const size_t numParts = message->parts.size();
+
+    while (framesSent < numParts)
+    {
+        const std::string& part = message->parts[framesSent];
+        const int flags = ZMQ_DONTWAIT | (framesSent < numParts - 1 ? ZMQ_SNDMORE : 0);
+
+        if (zmq_send (socket, part.data(), part.length(), flags) < 0)
+        {
+            const int err = zmq_errno();
+
+            // High-water mark reached: try again later
+            if (err == EAGAIN)
+                return false;
+
+            // A ROUTER peer we have only just connected to is unreachable until the
+            // connection is up, as is one that has gone away; wait a while for it
+            if (err == EHOSTUNREACH && framesSent == 0)
+            {
+                const int64_t now = nowMs();
+
+                if (unreachableSinceMs < 0)
+                    unreachableSinceMs = now;
+
+                if (now - unreachableSinceMs < UNREACHABLE_TIMEOUT_MS)
+                    return false;
+            }
+
+            // Anything else won't clear up by retrying, so the message is dropped. If
+            // some of its frames went out with ZMQ_SNDMORE the socket is left holding
+            // them until it is replaced.
+            std::cout << "Dropping message: " << zmq_strerror (err) << std::endl;
+
+            if (framesSent > 0)
+                unfinished = true;
+
+            droppedCount++;
+            return true;
+        }
+
+        framesSent++;
+    }
+
+    sentCount++;
+    return true;
+}
+
+void OutboundQueue::clear()
+{
+    const std::lock_guard<std::mutex> sl (lock);
+
+    head = 0;
+    count = 0;
+    framesSent = 0;
+    unfinished = false;
+    unreachableSinceMs = -1;
+    depth = 0;
+}
+
+void OutboundQueue::socketReplaced()
+{
+    const std::lock_guard<std::mutex> sl (lock);
+
+    // frames of the front message that went to the old socket are gone with it,
+    // and the new socket's peer gets a fresh chance to connect
+    framesSent = 0;
+    unfinished = false;
+    unreachableSinceMs = -1;
+}
+
+int OutboundQueue::getDepth() const
+{
+    return depth;
+}
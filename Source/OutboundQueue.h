@@ -0,0 +1,122 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __OUTBOUNDQUEUE_H_3F1A2C7E__
+#define __OUTBOUNDQUEUE_H_3F1A2C7E__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ A multipart ZMQ message waiting to be sent by the I/O thread.
+*/
+struct OutboundMessage
+{
+    std::vector<std::string> parts;
+};
+
+/**
+ Bounded queue of outbound messages, drained by the thread that owns the socket.
+
+ Any thread may push; only the socket owner may call flush(). Messages are sent
+ with ZMQ_DONTWAIT, so a peer that has reached its send high-water mark leaves
+ the remaining messages queued for the next flush instead of stalling the caller.
+ Pushing onto a full queue drops the new message and counts it, as does a
+ send that fails for any reason other than the high-water mark. A ROUTER peer
+ that is unreachable (usually because it is still connecting) holds up the
+ queue for a few seconds before the message to it is dropped.
+
+ Slots are allocated up front and keep their buffers after being sent, so once
+ they have grown to the sizes the traffic needs, pushing copies into existing
+ storage without allocating.
+*/
+class OutboundQueue
+{
+public:
+
+    /** Constructor */
+    OutboundQueue (int capacity = 1000);
+
+    /** Queue a message made of numParts frames for sending; returns false if the queue was full */
+    bool push (const std::string* const* parts, int numParts);
+
+    /** Send as many queued messages as the socket will accept without blocking.
+        Returns the number of messages completely sent. */
+    int flush (void* socket);
+
+    /** Discard any messages that have not been sent yet (socket owner only, after the socket is closed) */
+    void clear();
+
+    /** True if a message failed after some of its frames were sent. The socket still holds
+        those frames, so nothing more is sent until it is replaced. */
+    bool hasUnfinishedMessage() const { return unfinished; }
+
+    /** Start the front message again from its first frame on a new socket (socket owner only) */
+    void socketReplaced();
+
+    /** Number of messages waiting to be sent */
+    int getDepth() const;
+
+    /** Highest depth seen since construction */
+    int getMaxDepth() const { return maxDepth; }
+
+    /** Total messages sent */
+    uint64_t getSentCount() const { return sentCount; }
+
+    /** Total messages dropped because the queue was full or the send failed */
+    uint64_t getDroppedCount() const { return droppedCount; }
+
+    /** Number of times a push had to grow a slot's buffers */
+    uint64_t getAllocationCount() const { return allocationCount; }
+
+private:
+
+    /** Send the remaining frames of the front message; returns false if the socket would block,
+        true once the message has been sent or dropped */
+    bool sendFront (void* socket);
+
+    std::vector<OutboundMessage> slots;
+    size_t head;
+    size_t count;
+    size_t framesSent;
+    bool unfinished;
+
+    // when the front message first found its peer unreachable, or -1
+    int64_t unreachableSinceMs;
+
+    std::atomic<int> depth;
+    std::atomic<int> maxDepth;
+    std::atomic<uint64_t> sentCount;
+    std::atomic<uint64_t> droppedCount;
+    std::atomic<uint64_t> allocationCount;
+
+    std::mutex lock;
+
+    OutboundQueue (const OutboundQueue&) = delete;
+    OutboundQueue& operator= (const OutboundQueue&) = delete;
+};
+
+#endif  // __OUTBOUNDQUEUE_H_3F1A2C7E__
@@ -0,0 +1,100 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PeerLiveness.h"
+
+PeerLiveness::PeerLiveness (int maxMisses_)
+    : maxMisses         (maxMisses_ > 0 ? maxMisses_ : 1)
+    , probeOutstanding  (false)
+    , probeSentNanos    (0)
+    , heardSinceBeat    (false)
+    , state             (UNKNOWN)
+    , misses            (0)
+    , totalMisses       (0)
+    , reconnectCount    (0)
+    , rttNanos          (-1)
+    , smoothedRttNanos  (-1)
+{
+}
+
+void PeerLiveness::reset()
+{
+    probeOutstanding = false;
+    heardSinceBeat = false;
+    state = UNKNOWN;
+    misses = 0;
+    rttNanos = -1;
+    smoothedRttNanos = -1;
+}
+
+bool PeerLiveness::beat()
+{
+    // any traffic from the peer shows it is there, answered probe or not
+    if (probeOutstanding && ! heardSinceBeat)
+    {
+        misses++;
+        totalMisses++;
+        state = misses >= maxMisses ? DEAD : SUSPECT;
+    }
+
+    heardSinceBeat = false;
+
+    return state == DEAD;
+}
+
+void PeerLiveness::probeSent (int64_t nowNanos)
+{
+    // answers carry no sequence number, so a late answer to an earlier probe is
+    // timed against this one; with probes a heartbeat period apart that only
+    // matters for a peer that is barely alive anyway
+    probeSentNanos = nowNanos;
+    probeOutstanding = true;
+}
+
+void PeerLiveness::heard (int64_t nowNanos, bool answersProbe)
+{
+    heardSinceBeat = true;
+    misses = 0;
+    state = ALIVE;
+
+    if (answersProbe && probeOutstanding)
+    {
+        const int64_t rtt = nowNanos - probeSentNanos;
+        const int64_t smoothed = smoothedRttNanos;
+
+        rttNanos = rtt;
+        smoothedRttNanos = smoothed < 0 ? rtt : smoothed + (rtt - smoothed) / 8;
+        probeOutstanding = false;
+    }
+}
+
+const char* PeerLiveness::stateName (State state)
+{
+    switch (state)
+    {
+        case ALIVE:     return "alive";
+        case SUSPECT:   return "suspect";
+        case DEAD:      return "dead";
+        default:        return "connecting";
+    }
+}
@@ -0,0 +1,110 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PEERLIVENESS_H_6A4D1E97__
+#define __PEERLIVENESS_H_6A4D1E97__
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ Liveness of the peer at the other end of an endpoint, judged from heartbeats.
+
+ Every heartbeat period the I/O thread calls beat() and sends a probe the peer
+ has to answer. A period in which the last probe went unanswered and nothing
+ else arrived from the peer counts as a miss; after maxMisses in a row the
+ peer is declared dead and the caller reconnects. Round-trip times are taken
+ from probe to answer.
+
+ Updated by the I/O thread; the state and counters may be read from any thread.
+*/
+class PeerLiveness
+{
+public:
+
+    enum State
+    {
+        /** Connected but nothing heard yet */
+        UNKNOWN,
+        ALIVE,
+        /** Missed at least one heartbeat */
+        SUSPECT,
+        DEAD
+    };
+
+    /** Constructor */
+    PeerLiveness (int maxMisses = 3);
+
+    /** Start over after (re)connecting */
+    void reset();
+
+    /** A heartbeat period has passed: count a miss if the peer has been silent since the
+        last probe. Returns true if that makes the peer dead. */
+    bool beat();
+
+    /** A probe went out */
+    void probeSent (int64_t nowNanos);
+
+    /** A message arrived from the peer; answersProbe if it is the reply probes ask for */
+    void heard (int64_t nowNanos, bool answersProbe);
+
+    void setMaxMisses (int misses) { maxMisses = misses > 0 ? misses : 1; }
+
+    /** Note that the endpoint was reconnected after the peer was declared dead */
+    void countReconnect() { reconnectCount++; }
+
+    State getState() const { return State (state.load()); }
+    static const char* stateName (State state);
+
+    /** Heartbeats missed in a row */
+    int getMisses() const { return misses; }
+
+    uint64_t getTotalMisses() const { return totalMisses; }
+    uint64_t getReconnectCount() const { return reconnectCount; }
+
+    /** Most recent round trip, or -1 if none measured since reset() */
+    int64_t getRttNanos() const { return rttNanos; }
+
+    /** Round trip smoothed over the last several probes, or -1 */
+    int64_t getSmoothedRttNanos() const { return smoothedRttNanos; }
+
+private:
+
+    int maxMisses;
+    bool probeOutstanding;
+    int64_t probeSentNanos;
+    /** Set by heard(), cleared by beat() */
+    bool heardSinceBeat;
+
+    std::atomic<int> state;
+    std::atomic<int> misses;
+    std::atomic<uint64_t> totalMisses;
+    std::atomic<uint64_t> reconnectCount;
+    std::atomic<int64_t> rttNanos;
+    std::atomic<int64_t> smoothedRttNanos;
+
+    PeerLiveness (const PeerLiveness&) = delete;
+    PeerLiveness& operator= (const PeerLiveness&) = delete;
+};
+
+#endif  // __PEERLIVENESS_H_6A4D1E97__
@@ -0,0 +1,216 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PluginMetrics.h"
+
+#include <algorithm>
+#include <sstream>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::add (int64_t nanos)
+{
+    int bucket = 0;
+
+    // bucket n holds durations below 2^(n+1) ns
+    while (nanos > 1 && bucket < NUM_BUCKETS - 1)
+    {
+        nanos >>= 1;
+        bucket++;
+    }
+
+    buckets[bucket].fetch_add (1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+    uint64_t count = 0;
+
+    for (int i = 0; i < NUM_BUCKETS; i++)
+        count += buckets[i].load (std::memory_order_relaxed);
+
+    return count;
+}
+
+int64_t LatencyHistogram::getPercentileNanos (double fraction) const
+{
+    const uint64_t count = getCount();
+
+    if (count == 0)
+        return 0;
+
+    const uint64_t target = uint64_t (fraction * double (count - 1)) + 1;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        seen += buckets[i].load (std::memory_order_relaxed);
+
+        if (seen >= target)
+            return int64_t (1) << (i + 1);
+    }
+
+    return int64_t (1) << NUM_BUCKETS;
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < NUM_BUCKETS; i++)
+        buckets[i].store (0, std::memory_order_relaxed);
+}
+
+MessageTypeMetrics::MessageTypeMetrics()
+{
+    reset();
+}
+
+void MessageTypeMetrics::reset()
+{
+    received = 0;
+    handled = 0;
+    parseFailures = 0;
+    repliesSent = 0;
+
+    parseTime.reset();
+    handleTime.reset();
+}
+
+PluginMetrics::PluginMetrics()
+{
+}
+
+MessageTypeMetrics& PluginMetrics::forType (int handlerIndex)
+{
+    if (handlerIndex < 0 || handlerIndex >= MAX_MESSAGE_TYPES)
+        return types[MAX_MESSAGE_TYPES];
+
+    return types[handlerIndex];
+}
+
+const MessageTypeMetrics& PluginMetrics::forType (int handlerIndex) const
+{
+    if (handlerIndex < 0 || handlerIndex >= MAX_MESSAGE_TYPES)
+        return types[MAX_MESSAGE_TYPES];
+
+    return types[handlerIndex];
+}
+
+uint64_t PluginMetrics::totalReceived() const
+{
+    uint64_t total = 0;
+
+    for (const MessageTypeMetrics& m : types)
+        total += m.received.load (std::memory_order_relaxed);
+
+    return total;
+}
+
+uint64_t PluginMetrics::totalHandled() const
+{
+    uint64_t total = 0;
+
+    for (const MessageTypeMetrics& m : types)
+        total += m.handled.load (std::memory_order_relaxed);
+
+    return total;
+}
+
+uint64_t PluginMetrics::totalParseFailures() const
+{
+    uint64_t total = 0;
+
+    for (const MessageTypeMetrics& m : types)
+        total += m.parseFailures.load (std::memory_order_relaxed);
+
+    return total;
+}
+
+uint64_t PluginMetrics::totalRepliesSent() const
+{
+    uint64_t total = 0;
+
+    for (const MessageTypeMetrics& m : types)
+        total += m.repliesSent.load (std::memory_order_relaxed);
+
+    return total;
+}
+
+int64_t PluginMetrics::maxParsePercentileNanos (double fraction) const
+{
+    int64_t worst = 0;
+
+    for (const MessageTypeMetrics& m : types)
+        worst = std::max (worst, m.parseTime.getPercentileNanos (fraction));
+
+    return worst;
+}
+
+int64_t PluginMetrics::maxHandlePercentileNanos (double fraction) const
+{
+    int64_t worst = 0;
+
+    for (const MessageTypeMetrics& m : types)
+        worst = std::max (worst, m.handleTime.getPercentileNanos (fraction));
+
+    return worst;
+}
+
+static void writeTypeJson (std::ostringstream& out, const std::string& name, const MessageTypeMetrics& m)
+{
+    out << "\"" << name << "\":{"
+        << "\"received\":" << m.received.load (std::memory_order_relaxed)
+        << ",\"handled\":" << m.handled.load (std::memory_order_relaxed)
+        << ",\"parse_failures\":" << m.parseFailures.load (std::memory_order_relaxed)
+        << ",\"replies_sent\":" << m.repliesSent.load (std::memory_order_relaxed)
+        << ",\"parse_ns_p50\":" << m.parseTime.getPercentileNanos (0.5)
+        << ",\"parse_ns_p99\":" << m.parseTime.getPercentileNanos (0.99)
+        << ",\"handle_ns_p50\":" << m.handleTime.getPercentileNanos (0.5)
+        << ",\"handle_ns_p99\":" << m.handleTime.getPercentileNanos (0.99)
+        << "}";
+}
+
+std::string PluginMetrics::toJson (const std::vector<std::string>& typeNames) const
+{
+    std::ostringstream out;
+    out << "{";
+
+    for (size_t i = 0; i < typeNames.size() && i < size_t (MAX_MESSAGE_TYPES); i++)
+    {
+        writeTypeJson (out, typeNames[i], types[i]);
+        out << ",";
+    }
+
+    writeTypeJson (out, "unknown", types[MAX_MESSAGE_TYPES]);
+    out << "}";
+
+    return out.str();
+}
+
+void PluginMetrics::reset()
+{
+    for (MessageTypeMetrics& m : types)
+        m.reset();
+}
@@ -0,0 +1,123 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PLUGINMETRICS_H_E27C4A95__
+#define __PLUGINMETRICS_H_E27C4A95__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ Lock-free histogram of durations in power-of-two nanosecond buckets.
+
+ One thread adds samples; any thread may read. Percentiles are reported as the
+ upper edge of the bucket they fall in, so they are accurate to a factor of two.
+*/
+class LatencyHistogram
+{
+public:
+
+    static const int NUM_BUCKETS = 40;
+
+    /** Constructor */
+    LatencyHistogram();
+
+    /** Record one duration */
+    void add (int64_t nanos);
+
+    /** Number of recorded durations */
+    uint64_t getCount() const;
+
+    /** Upper bound, in nanoseconds, of the bucket holding the given fraction of samples */
+    int64_t getPercentileNanos (double fraction) const;
+
+    /** Forget all samples */
+    void reset();
+
+private:
+
+    std::atomic<uint64_t> buckets[NUM_BUCKETS];
+};
+
+/**
+ Counters for one message type.
+*/
+struct MessageTypeMetrics
+{
+    MessageTypeMetrics();
+
+    void reset();
+
+    std::atomic<uint64_t> received;
+    std::atomic<uint64_t> handled;
+    std::atomic<uint64_t> parseFailures;
+    std::atomic<uint64_t> repliesSent;
+
+    LatencyHistogram parseTime;
+    LatencyHistogram handleTime;
+};
+
+/**
+ Hot-path counters for the plugin's I/O thread, indexed by dispatcher handler.
+
+ Updated with relaxed atomic increments by the I/O thread only, so reading them
+ from the editor or answering a metrics request never stalls message handling.
+ Messages with no registered handler are counted under their own entry.
+*/
+class PluginMetrics
+{
+public:
+
+    static const int MAX_MESSAGE_TYPES = 32;
+
+    /** Constructor */
+    PluginMetrics();
+
+    /** Counters for a handler index; -1 or any out-of-range index selects the unknown-message entry */
+    MessageTypeMetrics& forType (int handlerIndex);
+    const MessageTypeMetrics& forType (int handlerIndex) const;
+
+    /** Sum a counter over all message types */
+    uint64_t totalReceived() const;
+    uint64_t totalHandled() const;
+    uint64_t totalParseFailures() const;
+    uint64_t totalRepliesSent() const;
+
+    /** Worst per-type percentile of parse and handle times */
+    int64_t maxParsePercentileNanos (double fraction) const;
+    int64_t maxHandlePercentileNanos (double fraction) const;
+
+    /** Compact JSON object with one entry per named message type plus "unknown" */
+    std::string toJson (const std::vector<std::string>& typeNames) const;
+
+    /** Zero every counter */
+    void reset();
+
+private:
+
+    MessageTypeMetrics types[MAX_MESSAGE_TYPES + 1];
+};
+
+#endif  // __PLUGINMETRICS_H_E27C4A95__
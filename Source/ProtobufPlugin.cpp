@@ -27,7 +27,20 @@
 #include "ProtobufPluginEditor.h"
 
 
-const int MAX_MESSAGE_LENGTH = 64000;
+const int SEND_HIGH_WATER_MARK = 1000;
+const int SEND_QUEUE_CAPACITY = 4096;
+const int COMMAND_QUEUE_CAPACITY = 256;
+const int MESSAGE_EVENT_QUEUE_CAPACITY = 256;
+const int PARAMETER_QUEUE_CAPACITY = 32;
+const int MAX_MESSAGE_ID_LENGTH = 64;
+const int EVENT_STREAM_CAPACITY = 4096;
+const int REPLAY_BATCH_SIZE = 1000;
+const int EXECUTOR_THREADS = 2;
+const int DEFAULT_HEARTBEAT_MS = 1000;
+const int DEFAULT_MAX_MISSED_HEARTBEATS = 3;
+/** message_header field a client sets to a fresh id per request, and keeps for its
+    retries; the generated header predates it, so it arrives as an unknown field */
+const int REQUEST_ID_FIELD_NUMBER = 5;
 
 
 #ifdef WIN32
@@ -39,20 +52,65 @@ const int MAX_MESSAGE_LENGTH = 64000;
 
 
 /*********************************************/
-void* ProtobufPlugin::zmqcontext = nullptr;
-
 ProtobufPlugin::ProtobufPlugin()
     : GenericProcessor  ("Protobuf Module")
     , Thread            ("ProtobufThread")
+    , executor          (EXECUTOR_THREADS, [this] { wakeup.wake(); })
+    , commandQueue      (COMMAND_QUEUE_CAPACITY)
+    , appliedCommandQueue (COMMAND_QUEUE_CAPACITY)
+    , acquisitionActive (false)
+    , parameterQueue    (PARAMETER_QUEUE_CAPACITY)
+    , messageEventQueue (MESSAGE_EVENT_QUEUE_CAPACITY)
+    , messageEventMask  (0)
+    , droppedMessageEvents (0)
+    , oversizedMessageEvents (0)
+    , replayHasRecord   (false)
+    , replayRealTime    (false)
+    , replayOffsetNanos (0)
+    , replaying         (false)
+    , replayRequest     (REPLAY_NONE)
+    , replayRequestRealTime (false)
+    , eventStream       (EVENT_STREAM_CAPACITY)
+    , eventStreamRestartPending (false)
+    , snippetStep       (0)
+    , snippetChannels   (0)
 {
 
 	GOOGLE_PROTOBUF_VERIFY_VERSION;
 
 	// # self.context = zmq.Context()
-    createZmqContext();
+	// shared by all instances; created when the first socket is opened, after
+	// the settings have been loaded
+    ZmqContext::retain();
+
+    registerHandlers();
+
+    for (int i = 0; i < dispatcher.getNumHandlers(); i++)
+        messageIdNames.add(String(dispatcher.getMessageId(i)));
+
+    const std::string routerAliveId = "router_alive";
+    const std::string devicesListId = "remote_devices_list";
+    routerAliveHandler = dispatcher.find(routerAliveId.data(), routerAliveId.length());
+    devicesListHandler = dispatcher.find(devicesListId.data(), devicesListId.length());
+
+    // commands are worth keeping next to the data; status polls are not
+    setMessageEventFilter("set_data_file_path,acquisition,recording");
+
+    headerTemplate.set("Open_Ephys", SystemStats::getComputerName().toStdString());
 
     firstTime = true;
-    router = nullptr;
+    currentArrivalNanos = 0;
+    currentHandler = -1;
+    currentEndpoint = -1;
+    currentRequestCached = false;
+    heartbeatIntervalMs = DEFAULT_HEARTBEAT_MS;
+    maxMissedHeartbeats = DEFAULT_MAX_MISSED_HEARTBEATS;
+    ioStartSeconds = 0;
+    lastArrivalNanos = 0;
+    registered = false;
+    registrationStartTicks = 0;
+    registrationDroppedCount = 0;
+    timeToReadyMs = 0;
     urlport = 9928;
 	url = "10.128.50.68";
     threadRunning = false;
@@ -74,20 +132,360 @@ String ProtobufPlugin::getListeningUrl ()
     return url;
 }
 
+int ProtobufPlugin::getSendQueueDepth() const
+{
+    int depth = 0;
+
+    for (int i = 0; i < endpoints.size(); i++)
+        depth += endpoints[i]->getSendQueue().getDepth();
+
+    return depth;
+}
+
+uint64 ProtobufPlugin::getDroppedSendCount() const
+{
+    uint64 dropped = 0;
+
+    for (int i = 0; i < endpoints.size(); i++)
+        dropped += endpoints[i]->getSendQueue().getDroppedCount();
+
+    return dropped;
+}
+
+uint64 ProtobufPlugin::getDroppedMessageEventCount() const
+{
+    return droppedMessageEvents + oversizedMessageEvents;
+}
+
+void ProtobufPlugin::setExtraEndpoints(const std::vector<EndpointConfig>& configs)
+{
+    extraEndpoints = configs;
+}
+
+const std::vector<EndpointConfig>& ProtobufPlugin::getExtraEndpoints() const
+{
+    return extraEndpoints;
+}
+
+void ProtobufPlugin::setMessageEventFilter(String filter)
+{
+    uint64 mask = 0;
+
+    if (filter.trim() == "*")
+    {
+        for (int i = 0; i < dispatcher.getNumHandlers(); i++)
+            mask |= uint64(1) << i;
+    }
+    else
+    {
+        StringArray ids;
+        ids.addTokens(filter, ",", "");
+
+        for (int i = 0; i < ids.size(); i++)
+        {
+            std::string id = ids[i].trim().toStdString();
+            int handlerIndex = dispatcher.find(id.data(), id.length());
+
+            if (handlerIndex >= 0 && handlerIndex < 64)
+                mask |= uint64(1) << handlerIndex;
+        }
+    }
+
+    messageEventFilter = filter;
+    messageEventMask = mask;
+}
+
+String ProtobufPlugin::getMessageEventFilter()
+{
+    return messageEventFilter;
+}
+
+void ProtobufPlugin::setEventStreamUrl(String streamUrl)
+{
+    eventStreamUrl = streamUrl.trim();
+
+    // process() is the stream's producer, so the socket can't change under it
+    if (acquisitionActive)
+        eventStreamRestartPending = true;
+    else
+        restart_event_stream();
+}
+
+String ProtobufPlugin::getEventStreamUrl()
+{
+    return eventStreamUrl;
+}
+
+void ProtobufPlugin::setSnippetDownsampling(int step, int numChannels)
+{
+    snippetStep = jmax(0, step);
+    snippetChannels = jmax(0, numChannels);
+}
+
+void ProtobufPlugin::setHeartbeat(int intervalMs, int maxMisses)
+{
+    heartbeatIntervalMs = jmax(0, intervalMs);
+    maxMissedHeartbeats = jmax(1, maxMisses);
+}
+
+int ProtobufPlugin::getHeartbeatIntervalMs() const
+{
+    return heartbeatIntervalMs;
+}
+
+int ProtobufPlugin::getMaxMissedHeartbeats() const
+{
+    return maxMissedHeartbeats;
+}
+
+const PeerLiveness* ProtobufPlugin::getRouterLiveness() const
+{
+    return threadRunning && peers.size() > 0 ? peers[0] : nullptr;
+}
+
+bool ProtobufPlugin::startCapture(String path)
+{
+    if (!capture.open(path.toStdString()))
+    {
+        CoreServices::sendStatusMessage("Protobuf: could not create capture file " + path);
+        return false;
+    }
+
+    return true;
+}
+
+void ProtobufPlugin::stopCapture()
+{
+    capture.close();
+}
+
+bool ProtobufPlugin::isCapturing() const
+{
+    return capture.isOpen();
+}
+
+void ProtobufPlugin::startReplay(String path, bool realTime)
+{
+    {
+        const ScopedLock sl(lock);
+        replayPath = path;
+        replayRequestRealTime = realTime;
+    }
+
+    replayRequest = REPLAY_START;
+    wakeup.wake();
+}
+
+void ProtobufPlugin::stopReplay()
+{
+    replayRequest = REPLAY_STOP;
+    wakeup.wake();
+}
+
+bool ProtobufPlugin::isReplaying() const
+{
+    return replaying;
+}
+
+void ProtobufPlugin::service_replay_request()
+{
+    const int request = replayRequest.exchange(REPLAY_NONE);
+
+    if (request == REPLAY_NONE)
+        return;
+
+    replayReader.close();
+    replayHasRecord = false;
+    replaying = false;
+
+    if (request != REPLAY_START)
+        return;
+
+    String path;
+
+    {
+        const ScopedLock sl(lock);
+        path = replayPath;
+        replayRealTime = replayRequestRealTime;
+    }
+
+    if (!replayReader.open(path.toStdString()) || !replayReader.next(replayRecord))
+    {
+        replayReader.close();
+        return;
+    }
+
+    // the first record plays straight away; the rest keep their spacing
+    replayHasRecord = true;
+    replayOffsetNanos = ArrivalClock::nowNanos() - replayRecord.timestampNanos;
+
+    std::cout << "Replaying " << path << (replayRealTime ? " at capture speed" : " as fast as possible") << std::endl;
+    replaying = true;
+}
+
+int ProtobufPlugin::replay_messages()
+{
+    if (!replaying)
+        return -1;
+
+    const int64 now = ArrivalClock::nowNanos();
+
+    for (int n = 0; n < REPLAY_BATCH_SIZE; n++)
+    {
+        if (!replayHasRecord)
+        {
+            if (!replayReader.next(replayRecord))
+            {
+                std::cout << "Replay finished" << std::endl;
+                replayReader.close();
+                replaying = false;
+                return -1;
+            }
+
+            replayHasRecord = true;
+        }
+
+        if (replayRealTime)
+        {
+            const int64 due = replayRecord.timestampNanos + replayOffsetNanos;
+
+            if (due > now)
+                return int(jmin(int64(100), (due - now + 999999) / 1000000));
+        }
+
+        replayHasRecord = false;
+
+        // replies are produced afresh by the handlers, so only received messages play
+        if (replayRecord.direction != CaptureRecord::RECEIVED || replayRecord.numFrames < 2)
+            continue;
+
+        const std::string& id = replayRecord.frames[replayRecord.numFrames - 2];
+        const std::string& payload = replayRecord.frames[replayRecord.numFrames - 1];
+
+        currentEndpoint = int(replayRecord.endpoint) < endpoints.size() ? int(replayRecord.endpoint) : 0;
+        handle_msg(dispatcher.find(id.data(), id.length()), payload.data(), payload.length(), now);
+        currentEndpoint = -1;
+    }
+
+    // more are due right away
+    return 0;
+}
+
+void ProtobufPlugin::restart_event_stream()
+{
+    eventStreamRestartPending = false;
+    eventStream.stop();
+
+    if (eventStreamUrl.isNotEmpty() && !eventStream.start(ZmqContext::get(), eventStreamUrl.toStdString()))
+        CoreServices::sendStatusMessage("Protobuf: could not start event stream on " + eventStreamUrl);
+}
+
+int64 ProtobufPlugin::getArrivalSampleNumber(int64 hostNanos) const
+{
+    return acquisitionActive ? arrivalClock.toSampleNumber(hostNanos) : -1;
+}
+
+int64 ProtobufPlugin::getLastArrivalSampleNumber() const
+{
+    return getArrivalSampleNumber(lastArrivalNanos);
+}
+
+const PluginMetrics& ProtobufPlugin::getMetrics() const
+{
+    return metrics;
+}
+
+std::string ProtobufPlugin::getMetricsJson() const
+{
+    std::vector<std::string> names;
+
+    for (int i = 0; i < dispatcher.getNumHandlers(); i++)
+        names.push_back(dispatcher.getMessageId(i));
+
+    std::string json = metrics.toJson(names);
+
+    // append the send path of each endpoint to the per-type object
+    json.pop_back();
+    json += ",\"endpoints\":[";
+
+    for (int i = 0; i < endpoints.size(); i++)
+    {
+        const Endpoint& endpoint = *endpoints[i];
+        const OutboundQueue& queue = endpoint.getSendQueue();
+
+        json += std::string(i > 0 ? "," : "") + "{\"name\":\"" + endpoint.getConfig().name
+            + "\",\"type\":\"" + EndpointConfig::socketTypeName(endpoint.getConfig().type)
+            + "\",\"open\":" + (endpoint.hasFailed() ? "false" : "true")
+            + ",\"received\":" + std::to_string(endpoint.getReceivedCount())
+            + ",\"rejected\":" + std::to_string(endpoint.getRejectedCount())
+            + ",\"send_queue\":{\"depth\":" + std::to_string(queue.getDepth())
+            + ",\"max_depth\":" + std::to_string(queue.getMaxDepth())
+            + ",\"sent\":" + std::to_string(queue.getSentCount())
+            + ",\"dropped\":" + std::to_string(queue.getDroppedCount()) + "}";
+
+        if (endpoint.getConfig().type == ZMQ_ROUTER && i < peers.size())
+        {
+            const PeerLiveness& peer = *peers[i];
+
+            json += ",\"peer\":{\"state\":\"" + std::string(PeerLiveness::stateName(peer.getState()))
+                + "\",\"missed_heartbeats\":" + std::to_string(peer.getTotalMisses())
+                + ",\"reconnects\":" + std::to_string(peer.getReconnectCount())
+                + ",\"rtt_ns\":" + std::to_string(peer.getRttNanos())
+                + ",\"rtt_smoothed_ns\":" + std::to_string(peer.getSmoothedRttNanos()) + "}";
+        }
+
+        json += "}";
+    }
+
+    uint64 sendBufferAllocations = 0;
+    const ZmqContextSettings zmqSettings = ZmqContext::getActiveSettings();
+
+    for (int i = 0; i < endpoints.size(); i++)
+        sendBufferAllocations += endpoints[i]->getSendQueue().getAllocationCount();
+
+    json += "],\"allocations\":{\"messages\":" + std::to_string(replyPool.getAllocationCount())
+        + ",\"messages_reused\":" + std::to_string(replyPool.getReuseCount())
+        + ",\"send_buffers\":" + std::to_string(sendBufferAllocations)
+        + "},\"executor\":{\"submitted\":" + std::to_string(executor.getSubmittedCount())
+        + ",\"completed\":" + std::to_string(executor.getCompletedCount())
+        + ",\"queue_delay_p99_ns\":" + std::to_string(executor.getQueueDelay().getPercentileNanos(0.99))
+        + ",\"queue_delay_max_ns\":" + std::to_string(executor.getMaxQueueDelayNanos())
+        + "},\"event_stream\":{\"batches\":" + std::to_string(eventStream.getBatchCount())
+        + ",\"records\":" + std::to_string(eventStream.getRecordCount())
+        + ",\"dropped\":" + std::to_string(eventStream.getDroppedCount())
+        + "},\"message_events\":{\"dropped\":" + std::to_string(droppedMessageEvents.load())
+        + ",\"oversized\":" + std::to_string(oversizedMessageEvents.load())
+        + ",\"max_payload\":" + std::to_string(MAX_EVENT_PAYLOAD)
+        + "},\"reply_cache\":{\"hits\":" + std::to_string(replyCache.getHitCount())
+        + ",\"pending_hits\":" + std::to_string(replyCache.getPendingHitCount())
+        + ",\"misses\":" + std::to_string(replyCache.getMissCount())
+        + ",\"evictions\":" + std::to_string(replyCache.getEvictionCount())
+        + "},\"zmq\":{\"io_threads\":" + std::to_string(zmqSettings.ioThreads)
+        + ",\"max_sockets\":" + std::to_string(zmqSettings.maxSockets)
+        + ",\"io_cpus\":\"" + zmqSettings.cpusToString()
+        + "\",\"instances\":" + std::to_string(ZmqContext::getUserCount())
+        + "},\"time_to_ready_ms\":" + std::to_string(timeToReadyMs.load()) + "}";
+
+    return json;
+}
+
+bool ProtobufPlugin::isRegistered() const
+{
+    return registered;
+}
+
+double ProtobufPlugin::getTimeToReadyMs() const
+{
+    return timeToReadyMs;
+}
+
 void ProtobufPlugin::setNewListeningPort(int port)
 {
     // first, close existing thread.
     bool shutdown_ok = closesocket();
 
-    // allow some time for thread to quit
-
 	if (shutdown_ok)
 	{
-#ifdef WIN32
-		Sleep(300);
-#else
-		usleep(300 * 1000);
-#endif
 		urlport = port;
 		opensocket();
 
@@ -104,13 +502,6 @@ void ProtobufPlugin::setNewListeningUrl(String _url)
 
 	if (shutdown_ok)
 	{
-	// allow some time for thread to quit
-#ifdef WIN32
-	Sleep(300);
-#else
-	usleep(300 * 1000);
-#endif
-
 	url = _url;
 	opensocket();
 
@@ -123,7 +514,17 @@ void ProtobufPlugin::setNewListeningUrl(String _url)
 ProtobufPlugin::~ProtobufPlugin()
 {
     shutdown = true;
-    closesocket();
+
+    // every socket on the context has to be closed before the last instance can destroy it
+    if (!closesocket())
+    {
+        std::cerr << "I/O thread still running, leaving the ZMQ context open" << std::endl;
+        return;
+    }
+
+    eventStream.stop();
+    wakeup.close();
+    ZmqContext::release();
 }
 
 
@@ -131,8 +532,14 @@ bool ProtobufPlugin::closesocket()
 {
     std::cout << "Closing socket" << std::endl;
 
-    if (threadRunning)
+    // threadRunning is only set once run() has opened the endpoints, so a thread
+    // still starting up has to be stopped too before they are rebuilt
+    if (isThreadRunning())
     {
+		// the I/O thread blocks in zmq_poll until something happens, so poke it
+		signalThreadShouldExit();
+		wakeup.wake();
+
 		if (!stopThread(500))
 		{
 			std::cerr << "Failed to stop thread." << std::endl;
@@ -140,13 +547,6 @@ bool ProtobufPlugin::closesocket()
 		}
 		else {
 			std::cout << "Successfully shut down thread" << std::endl;
-
-			if (shutdown)
-			{
-				std::cout << "Destroying context" << std::endl;
-				zmq_close(router);
-				zmq_ctx_destroy(zmqcontext);
-			}
 		}
     }
 
@@ -168,270 +568,968 @@ void ProtobufPlugin::opensocket()
 {
 	std::cout << "Opening socket." << std::endl;
     
-	if (!threadRunning)
+	if (!isThreadRunning())
+	{
+		if (wakeup.getSocket() == nullptr)
+			wakeup.open(ZmqContext::get(), "protobuf-control-" + String::toHexString((pointer_sized_int) this).toStdString());
+
+		createEndpoints();
 		startThread();
+	}
+}
+
+void ProtobufPlugin::createEndpoints()
+{
+	endpoints.clear();
+	peers.clear();
+
+	EndpointConfig primary;
+	primary.name = "router";
+	primary.type = ZMQ_ROUTER;
+	primary.url = (String("tcp://") + url + ":" + String(urlport)).toStdString();
+	endpoints.add(new Endpoint(primary, SEND_QUEUE_CAPACITY));
+
+	for (const EndpointConfig& config : extraEndpoints)
+		endpoints.add(new Endpoint(config, SEND_QUEUE_CAPACITY));
+
+	// an endpoint with a message list only passes those ids on to the handlers
+	for (int i = 0; i < endpoints.size(); i++)
+	{
+		uint64 mask = 0;
+
+		for (int h = 0; h < dispatcher.getNumHandlers() && h < 64; h++)
+		{
+			if (endpoints[i]->routes(dispatcher.getMessageId(h)))
+				mask |= uint64(1) << h;
+		}
+
+		endpoints[i]->setAcceptedHandlers(mask);
+		endpoints[i]->setCapture(&capture, uint32(i));
+
+		peers.add(new PeerLiveness(maxMissedHeartbeats));
+	}
 }
 
-void ProtobufPlugin::register_for_msg(String msg_id)
+void ProtobufPlugin::register_for_msg(Endpoint* endpoint, String msg_id)
 {
 	// # io.register_for_message('request_system_status', handle_system_status)
 
-	message_header* header = message.mutable_header(); // = message.header;
-	generate_msg_header(header, msg_id);
-	
-	//message.set_allocated_header(header);
+	register_for_message& message = replyPool.acquire<register_for_message>();
+
 	message.set_message_id(msg_id.toStdString());
 
 	std::cout << "  " << message.message_id() << std::endl;
 	
 	std::string resp1 = String("router").toStdString();
 	std::string message_id = String("register_for_message").toStdString();
-	std::string message_string = message.SerializeAsString();
-
-	send_multipart_msg(resp1, message_id, message_string);
-
-	
 
+	endpoint->send(resp1, message_id, serialize_msg(message.message_id(), message));
 }
 
-void ProtobufPlugin::send_multipart_msg(std::string part1, std::string part2, std::string part3)
+void ProtobufPlugin::register_all_msgs()
 {
-	int rc = zmq_send(router, part1.c_str(), part1.length(), ZMQ_SNDMORE);
-	rc = zmq_send(router, part2.c_str(), part2.length(), ZMQ_SNDMORE);
-	rc = zmq_send(router, part3.c_str(), part3.length(), 0);
-
-#ifdef WIN32
-	Sleep(20);
-#else
-	usleep(20 * 1000);
-#endif
+	// all registrations are queued back-to-back; the send queue retries them for a
+	// few seconds while the router connection comes up, so no settling delay is needed
+	registered = false;
+	registrationStartTicks = Time::getHighResolutionTicks();
+	registrationDroppedCount = endpoints.size() > 0 ? endpoints[0]->getSendQueue().getDroppedCount() : 0;
+
+	for (int e = 0; e < endpoints.size(); e++)
+		register_endpoint_msgs(e);
 }
 
-void ProtobufPlugin::generate_msg_header(message_header* header, String id)
+void ProtobufPlugin::register_endpoint_msgs(int endpointIndex)
 {
-	header->set_host(SystemStats::getComputerName().getCharPointer());
-	header->set_process(String("Open_Ephys").getCharPointer());
-	header->set_timestamp(float(Time::currentTimeMillis()));
-	header->set_message_id(id.toStdString());
+	Endpoint* endpoint = endpoints[endpointIndex];
+
+	if (endpoint->getConfig().type != ZMQ_ROUTER || endpoint->getSocket() == nullptr)
+		return;
+
+	// each router only hears about the messages its endpoint passes on
+	std::cout << "Registering for messages on " << endpoint->getConfig().name << ":" << std::endl;
+	for (int i = 0; i < dispatcher.getNumHandlers(); i++)
+	{
+		if (dispatcher.isSubscribed(i) && endpoint->accepts(i))
+			register_for_msg(endpoint, dispatcher.getMessageId(i));
+	}
+
+	// the router answers in order, so its reply to this confirms the registrations above;
+	// it doubles as the first heartbeat probe
+	static const std::string request_id = "request_remote_devices";
+	request_remote_devices& request = replyPool.acquire<request_remote_devices>();
+
+	endpoint->send("router", request_id, serialize_msg(request_id, request));
+	peers[endpointIndex]->probeSent(ArrivalClock::nowNanos());
 }
 
-void ProtobufPlugin::handle_msg(std::string msg, String message_id)
+void ProtobufPlugin::heartbeat(int endpointIndex)
 {
-	std::cout << "Handling that message." << std::endl;
+	static const std::string heartbeat_id = "generic_heartbeat";
+	static const std::string probe_id = "request_remote_devices";
 
-	//String message_id;
+	const int64 now = ArrivalClock::nowNanos();
+	Endpoint* endpoint = endpoints[endpointIndex];
+	PeerLiveness& peer = *peers[endpointIndex];
 
-	if (message_id.equalsIgnoreCase("request_system_info"))
+	if (peer.beat())
+	{
+		reconnect_endpoint(endpointIndex);
+	}
+	else
 	{
-		request_system_info rsi;
-		rsi.ParseFromString(msg);
+		generic_heartbeat& beat = replyPool.acquire<generic_heartbeat>();
+		beat.set_start_time(ioStartSeconds);
+		endpoint->send("router", heartbeat_id, serialize_msg(heartbeat_id, beat));
+
+		// the router doesn't answer heartbeats, so ask it something it does answer
+		request_remote_devices& probe = replyPool.acquire<request_remote_devices>();
+		endpoint->send("router", probe_id, serialize_msg(probe_id, probe));
+		peer.probeSent(now);
+	}
 
-		String id = String("system_info");
-		CoreServices::sendStatusMessage(String("Message: request_system_info."));
+	timers.schedule(endpointIndex, now + int64(heartbeatIntervalMs) * 1000000);
+}
 
-		system_info info;
-		std::string version_string = String("version string").toStdString();
-		std::string revision_string = String("hi.").toStdString();
-		info.set_software_revision(version_string.c_str());
-		info.set_hardware_revision(revision_string.c_str());
+void ProtobufPlugin::reconnect_endpoint(int endpointIndex)
+{
+	Endpoint* endpoint = endpoints[endpointIndex];
 
-		message_header* header = info.mutable_header();
-		generate_msg_header(header, id);
+	std::cout << "No answer from " << endpoint->getConfig().name << " for "
+		<< peers[endpointIndex]->getMisses() << " heartbeats, reconnecting" << std::endl;
 
-		std::string resp1 = String("router").toStdString();
-		std::string resp2 = id.toStdString();
-		std::string message_string = info.SerializeAsString();
+	// a fresh socket reconnects right away rather than on ZMQ's retry timer, and a
+	// restarted router has forgotten our registrations anyway
+	peers[endpointIndex]->reset();
+	peers[endpointIndex]->countReconnect();
 
-		send_multipart_msg(resp1, resp2, message_string);
+	if (!endpoint->open(ZmqContext::get(), socketIdentity, SEND_HIGH_WATER_MARK))
+		return;
 
-	}
-	else if (message_id.equalsIgnoreCase("request_system_status")) // request_system_status
+	if (endpointIndex == 0)
 	{
-		request_system_status rss;
-		rss.ParseFromString(msg);
+		registered = false;
+		registrationStartTicks = Time::getHighResolutionTicks();
+		registrationDroppedCount = endpoint->getSendQueue().getDroppedCount();
+	}
 
-		String id = String("system_status");
+	register_endpoint_msgs(endpointIndex);
+}
 
-		CoreServices::sendStatusMessage(String("Message: request_system_status."));
+void ProtobufPlugin::registration_confirmed()
+{
+	if (registered)
+		return;
 
-		system_status status;
-		status.set_status(system_status_status_type_READY);
+	timeToReadyMs = 1000.0 * double(Time::getHighResolutionTicks() - registrationStartTicks)
+		/ double(Time::getHighResolutionTicksPerSecond());
+	registered = true;
 
-		message_header* header = status.mutable_header();
-		generate_msg_header(header, id);
+	std::cout << "Registered with router after " << timeToReadyMs << " ms" << std::endl;
+}
 
-		std::string resp1 = String("router").toStdString();
-		std::string resp2 = id.toStdString();
-		std::string message_string = status.SerializeAsString();
+void ProtobufPlugin::send_multipart_msg(const std::string& part1, const std::string& part2, const std::string& part3)
+{
+	// replies go back where the request came from, anything else to the primary router
+	const bool onIoThread = Thread::getCurrentThreadId() == getThreadId();
+
+	if (onIoThread && currentEndpoint >= 0 && currentEndpoint < endpoints.size()
+		&& endpoints[currentEndpoint]->getConfig().type == ZMQ_ROUTER)
+		send_to_endpoint(currentEndpoint, endpoints[currentEndpoint]->getCurrentPeer(), part2, part3);
+	else
+		send_to_endpoint(onIoThread ? currentEndpoint : -1, part1, part2, part3);
+}
 
-		send_multipart_msg(resp1, resp2, message_string);
-	}
-	else if (message_id.equalsIgnoreCase("acquisition")) // acquisition
-	{
+void ProtobufPlugin::send_to_endpoint(int endpointIndex, const std::string& peer, const std::string& id, const std::string& payload)
+{
+	if (endpoints.size() == 0)
+		return;
 
-		acquisition acq;
-		acq.ParseFromString(msg);
+	// SUB and PUB endpoints can't be replied on
+	Endpoint* target = endpoints[0];
+	const bool onIoThread = Thread::getCurrentThreadId() == getThreadId();
 
-		if (acq.command() == 0)
-		{
-			// stop acquisition
-			CoreServices::sendStatusMessage(String("Message: stop acquisition."));
-			CoreServices::setAcquisitionStatus(false);
-		}
-		else {
-			// start acquisition
-			CoreServices::sendStatusMessage(String("Message: start acquisition."));
-			CoreServices::setAcquisitionStatus(true);
-		}
-	}
-	else if (message_id.equalsIgnoreCase("recording")) // recording
+	if (endpointIndex >= 0 && endpointIndex < endpoints.size())
 	{
+		int type = endpoints[endpointIndex]->getConfig().type;
 
-		recording rec;
-		rec.ParseFromString(msg);
-
-		if (rec.command() == 0)
-		{
-			// stop recording
-			CoreServices::sendStatusMessage(String("Message: stop recording."));
-			CoreServices::setRecordingStatus(false);
-			//return String("StartedRecording");
-		}
-		else {
-			CoreServices::sendStatusMessage(String("Message: start recording."));
-			CoreServices::setRecordingStatus(true);
-			// start recording
-		}
+		if (type == ZMQ_ROUTER || type == ZMQ_DEALER)
+			target = endpoints[endpointIndex];
 	}
-	else if (message_id.equalsIgnoreCase("set_data_file_path")) // set data file path
+
+	// PUB endpoints get a copy of every outgoing message on their list
+	for (int i = 0; i < endpoints.size(); i++)
 	{
+		if (endpoints[i]->getConfig().type == ZMQ_PUB && endpoints[i]->routes(id))
+			endpoints[i]->send(peer, id, payload);
+	}
 
-		set_data_file_path sdfp;
-		sdfp.ParseFromString(msg);
+	// queued here, sent by the I/O thread after the current batch of messages is handled
+	if (!target->send(peer, id, payload))
+		std::cout << "Send queue full, dropping message." << std::endl;
+	else if (onIoThread && currentHandler >= 0)
+		metrics.forType(currentHandler).repliesSent++;
 
-		CoreServices::sendStatusMessage(String("Message: set_data_file_path."));
-		String path = String(sdfp.path());
-		
-        CoreServices::setRecordingDirectoryPrependText(path);
-		CoreServices::createNewRecordingDirectory();
+	// the I/O thread flushes after every batch; anyone else has to wake it
+	if (!onIoThread)
+		wakeup.wake();
+}
 
-	}
-	else {
-		CoreServices::sendStatusMessage(String("Message: not recognized."));
-	}
+const std::string& ProtobufPlugin::serialize_msg(const std::string& id, const google::protobuf::Message& message)
+{
+	// a float can't hold epoch milliseconds (it steps by about two minutes), so
+	// send monotonic seconds since the plugin was loaded instead
+	headerTemplate.serialize(message, id, float(ArrivalClock::secondsSinceOrigin()), &replyBuffer);
+	return replyBuffer;
+}
+
+void ProtobufPlugin::send_reply(const std::string& id, const google::protobuf::Message& reply)
+{
+	static const std::string router = "router";
+
+	send_multipart_msg(router, id, serialize_msg(id, reply));
 
+	// a retry of this request gets the same bytes back
+	if (currentRequestCached)
+		replyCache.complete(currentRequestKey, id, replyBuffer);
 }
 
-void ProtobufPlugin::run()
+bool ProtobufPlugin::is_retry(const message_header& header, uint64 discriminator)
 {
-	// # io = ZMQHandler(messages)
-	// 
-    router = zmq_socket (zmqcontext, ZMQ_ROUTER);
-	int timeoutvalue = 100;
-	int probe_router = 1;
-	int lingervalue = 0;
-    String identitystring = String("OpenEphys_") + SystemStats::getComputerName();
-#ifdef WIN32
-    identitystring += "_" + String(_getpid());
-#endif
-	std::string identity = identitystring.toStdString();
-	zmq_setsockopt(router, ZMQ_RCVTIMEO, &timeoutvalue, sizeof timeoutvalue);
-	zmq_setsockopt(router, ZMQ_IDENTITY, identity.c_str(), identity.length());
-	zmq_setsockopt(router, ZMQ_PROBE_ROUTER, &probe_router, sizeof probe_router);
-	zmq_setsockopt(router, ZMQ_LINGER, &lingervalue, sizeof lingervalue);
-    String full_url = String ("tcp://") + String(url) + ":" + String (urlport);
+	static const std::string router = "router";
 
-	std::cout << "Connecting to " << full_url << std::endl;
-    int rc = zmq_connect (router, full_url.toRawUTF8());
+	// without a request id a repeat can't be told from a new request, so nothing is deduplicated
+	const google::protobuf::UnknownFieldSet& unknown = header.unknown_fields();
+	int requestIdIndex = -1;
 
-	if (rc != 0)
+	for (int i = 0; i < unknown.field_count(); i++)
 	{
-		// failed to open socket?
-		std::cout << "Failed to open socket: " << zmq_strerror(zmq_errno()) << std::endl;
-		zmq_close(router);
-		return;
+		if (unknown.field(i).number() == REQUEST_ID_FIELD_NUMBER
+			&& unknown.field(i).type() == google::protobuf::UnknownField::TYPE_VARINT)
+			requestIdIndex = i;
 	}
 
-	// allow time for connection to register
-#ifdef WIN32
-	Sleep(500);
-#else
-	usleep(500 * 1000);
-#endif
-
-	std::cout << "Registering for messages:" << std::endl;
-	register_for_msg("set_data_file_path");
-	register_for_msg("request_system_info");
-	register_for_msg("request_system_status");
-	register_for_msg("acquisition");
-	register_for_msg("recording");
-    // # io.register_for_message('request_system_info', handle_system_info)
-	// # io.register_for_message('set_data_file_path', handle_set_data_file_path)
-
-	// set up polling
-	zmq_pollitem_t item[2];
-	item[0].socket = router;
-	item[0].events = ZMQ_POLLIN;
-	item[1].socket = router;
-	item[1].events = ZMQ_POLLIN;
+	if (requestIdIndex < 0)
+		return false;
 
-    threadRunning = true;
-    unsigned char* buffer = new unsigned char[MAX_MESSAGE_LENGTH];
-    int result = -1;
+	ReplyCache::Key key = ReplyCache::makeKey(header.host(), header.process(),
+		unknown.field(requestIdIndex).varint(), discriminator);
+	const std::string* id;
+	const std::string* reply;
 
-	while (!threadShouldExit())
+	switch (replyCache.lookup(key, currentArrivalNanos, &id, &reply))
 	{
-		int rc = zmq_poll(item, 2, 100);
+	case ReplyCache::HIT:
+		send_multipart_msg(router, *id, *reply);
+		return true;
+	case ReplyCache::PENDING:
+		// the reply goes out when the first attempt finishes
+		return true;
+	case ReplyCache::MISS:
+		break;
+	}
+
+	replyCache.insert(key, currentArrivalNanos);
+	currentRequestCached = true;
+	currentRequestKey = key;
+	return false;
+}
+
+void ProtobufPlugin::send_command_status(const std::string& sourceId, const std::string& text)
+{
+	static const std::string id = "system_status";
+
+	system_status& status = replyPool.acquire<system_status>();
+	status.set_status(system_status_status_type_READY);
+	status.set_source_message_id(sourceId);
+	status.mutable_message()->assign(text);
+
+	send_reply(id, status);
+}
+
+void ProtobufPlugin::registerHandlers()
+{
+	// one entry per message type: the same table drives dispatch and router registration
+	dispatcher.add<set_data_file_path>("set_data_file_path",
+		[this](const set_data_file_path& m) { handle_set_data_file_path(m); });
+	dispatcher.add<request_system_info>("request_system_info",
+		[this](const request_system_info& m) { handle_request_system_info(m); });
+	dispatcher.add<request_system_status>("request_system_status",
+		[this](const request_system_status& m) { handle_request_system_status(m); });
+	dispatcher.add<request_system_status>("request_metrics",
+		[this](const request_system_status& m) { handle_request_metrics(m); });
+	dispatcher.add<acquisition>("acquisition",
+		[this](const acquisition& m) { handle_acquisition(m); });
+	dispatcher.add<recording>("recording",
+		[this](const recording& m) { handle_recording(m); });
+	dispatcher.add<remote_service_request>("remote_service_request",
+		[this](const remote_service_request& m) { handle_remote_service_request(m); });
+
+	// sent by the router itself, so not registered for
+	dispatcher.add<router_alive>("router_alive",
+		[this](const router_alive& m) { handle_router_alive(m); }, false);
+	dispatcher.add<remote_devices_list>("remote_devices_list",
+		[this](const remote_devices_list& m) { handle_remote_devices_list(m); }, false);
+}
+
+void ProtobufPlugin::handle_msg(int handlerIndex, const void* msg, size_t size, int64 arrivalNanos)
+{
+	currentArrivalNanos = arrivalNanos;
+	lastArrivalNanos = arrivalNanos;
+
+	MessageTypeMetrics& counters = metrics.forType(handlerIndex);
+	counters.received++;
+
+	post_message_event(handlerIndex, msg, size, arrivalNanos);
+
+	if (handlerIndex < 0)
+	{
+		CoreServices::sendStatusMessage(String("Message: not recognized."));
+		return;
+	}
+
+	int64 parseStart = ArrivalClock::nowNanos();
+
+	if (!dispatcher.parse(handlerIndex, msg, size))
+	{
+		counters.parseFailures++;
+		CoreServices::sendStatusMessage(String("Message: could not be parsed."));
+		return;
+	}
+
+	int64 handleStart = ArrivalClock::nowNanos();
+	counters.parseTime.add(handleStart - parseStart);
+
+	currentHandler = handlerIndex;
+	dispatcher.handle(handlerIndex);
+	currentHandler = -1;
+	currentRequestCached = false;
+
+	counters.handleTime.add(ArrivalClock::nowNanos() - handleStart);
+	counters.handled++;
+}
+
+void ProtobufPlugin::handle_request_system_info(const request_system_info& rsi)
+{
+	static const std::string id = "system_info";
+	static const std::string version_string = "version string";
+	static const std::string revision_string = "hi.";
+
+	CoreServices::sendStatusMessage(String("Message: request_system_info."));
+
+	system_info& info = replyPool.acquire<system_info>();
+	info.set_software_revision(version_string);
+	info.set_hardware_revision(revision_string);
+
+	send_reply(id, info);
+}
+
+void ProtobufPlugin::handle_request_system_status(const request_system_status& rss)
+{
+	static const std::string id = "system_status";
+	static const std::string source_id = "request_system_status";
+
+	CoreServices::sendStatusMessage(String("Message: request_system_status."));
+
+	char text[96];
+	snprintf(text, sizeof(text), "send_queue_depth=%d dropped_sends=%llu",
+		getSendQueueDepth(), (unsigned long long) getDroppedSendCount());
+
+	system_status& status = replyPool.acquire<system_status>();
+	status.set_status(system_status_status_type_READY);
+	status.set_source_message_id(source_id);
+	status.mutable_message()->assign(text);
+
+	send_reply(id, status);
+}
+
+void ProtobufPlugin::handle_request_metrics(const request_system_status& request)
+{
+	// a header-only request, so it shares request_system_status's message type
+	static const std::string id = "plugin_metrics";
 
-		if (item[0].revents & ZMQ_POLLIN)
+	system_notification& reply = replyPool.acquire<system_notification>();
+	reply.set_status(system_notification_status_type_UPDATE);
+	reply.set_message(getMetricsJson());
+
+	send_reply(id, reply);
+}
+
+void ProtobufPlugin::handle_acquisition(const acquisition& acq)
+{
+	static const std::string source_id = "acquisition";
+
+	// a client retrying after a timeout mustn't start or stop twice
+	if (is_retry(acq.header(), acq.command()))
+		return;
+
+	if (acq.command() == 0)
+		post_command(NetworkCommand::STOP_ACQUISITION, acq.header());
+	else
+		post_command(NetworkCommand::START_ACQUISITION, acq.header());
+
+	send_command_status(source_id, acq.command() == 0 ? "command=stop" : "command=start");
+}
+
+void ProtobufPlugin::handle_recording(const recording& rec)
+{
+	static const std::string source_id = "recording";
+
+	if (is_retry(rec.header(), rec.command()))
+		return;
+
+	if (rec.command() == 0)
+		post_command(NetworkCommand::STOP_RECORDING, rec.header());
+	else
+		post_command(NetworkCommand::START_RECORDING, rec.header());
+
+	send_command_status(source_id, rec.command() == 0 ? "command=stop" : "command=start");
+}
+
+std::string ProtobufPlugin::client_key(const message_header& header)
+{
+	return header.host() + "/" + header.process();
+}
+
+void ProtobufPlugin::post_command(NetworkCommand::Type type, const message_header& header)
+{
+	const int64 arrivalNanos = currentArrivalNanos;
+
+	// e.g. start recording must wait for the directory set just before it
+	if (executor.isBusy())
+	{
+		const std::string client = client_key(header);
+
+		if (executor.isBusy(client))
 		{
-			std::cout << "Got a message!" << std::endl;
-
-			int messageNum = 0;
-			String message_id;
-			int64_t more = 0;
-			size_t more_size = sizeof more;
-
-			do {
-				rc = zmq_recv(router, buffer, MAX_MESSAGE_LENGTH - 1, 0);
-				
-				std::string s(reinterpret_cast<char const*> (buffer));
-				std::cout << "Received: " << std::endl;
-				std::cout << s << std::endl;
-				memset(buffer, 0, MAX_MESSAGE_LENGTH);
-	
-				//std::cout << messageNum << std::endl;
-				//std::cout << s << std::endl;
-				//std::cout << " " << std::endl;
+			executor.submit(client, nullptr, [this, type, arrivalNanos] { queue_command(type, arrivalNanos); });
+			return;
+		}
+	}
+
+	queue_command(type, arrivalNanos);
+}
+
+void ProtobufPlugin::queue_command(NetworkCommand::Type type, int64 arrivalNanos)
+{
+	NetworkCommand command;
+	command.type = type;
+	command.arrivalNanos = arrivalNanos;
+	command.arrivalSample = -1;
+	command.sampleNumber = -1;
+
+	if (!commandQueue.push(command))
+	{
+		std::cout << "Command queue full, dropping command." << std::endl;
+		return;
+	}
 
-				if (messageNum == 0) // client
-				{
-					
-				}
-				else if (messageNum == 1) // message_id
-				{
-					message_id = String(s);
-				}
-				else if (messageNum == 2)
-				{
-					handle_msg(s, message_id);
-				}
+	// process() isn't running to pick it up, so let the message thread do it
+	if (!acquisitionActive)
+		triggerAsyncUpdate();
+}
 
-				messageNum++;
+void ProtobufPlugin::post_message_event(int handlerIndex, const void* msg, size_t size, int64 arrivalNanos)
+{
+	if (!acquisitionActive || handlerIndex < 0 || handlerIndex >= 64
+		|| (messageEventMask & (uint64(1) << handlerIndex)) == 0)
+		return;
 
-				rc = zmq_getsockopt(router, ZMQ_RCVMORE, &more, &more_size);
+	if (size > MAX_EVENT_PAYLOAD)
+	{
+		oversizedMessageEvents++;
+		return;
+	}
 
-			} while (more);
+	MessageEvent* slot = messageEventQueue.beginPush();
 
+	if (slot == nullptr)
+	{
+		droppedMessageEvents++;
+		return;
+	}
+
+	slot->handlerIndex = handlerIndex;
+	slot->arrivalNanos = arrivalNanos;
+	int channelIndex = 0;
+
+	while (size_t(MESSAGE_CHANNEL_SIZES[channelIndex]) < size)
+		channelIndex++;
+
+	slot->size = uint32(size);
+	slot->channelIndex = channelIndex;
+	memcpy(slot->payload, msg, size);
+
+	// the event carries its channel's whole data size, so don't record stale bytes
+	memset(slot->payload + size, 0, MESSAGE_CHANNEL_SIZES[channelIndex] - size);
+
+	messageEventQueue.commitPush();
+}
+
+void ProtobufPlugin::add_message_events(int64 blockStart)
+{
+	MessageEvent* slot;
+
+	while ((slot = messageEventQueue.front()) != nullptr)
+	{
+		const EventChannel* channel = messageChannels[slot->channelIndex];
+
+		if (channel != nullptr)
+		{
+			int64 arrivalSample = arrivalClock.toSampleNumber(slot->arrivalNanos);
+
+			messageEventMetaData[0]->setValue(slot->arrivalNanos);
+			messageEventMetaData[1]->setValue(slot->size);
+			messageEventMetaData[2]->setValue(messageIdNames[slot->handlerIndex]);
+
+			BinaryEventPtr event = BinaryEvent::createBinaryEvent(channel,
+				arrivalSample >= 0 ? arrivalSample : blockStart,
+				slot->payload, MESSAGE_CHANNEL_SIZES[slot->channelIndex], messageEventMetaData);
+			addEvent(channel, event, 0);
 		}
-    }
 
-    //zmq_close (router);
+		messageEventQueue.popFront();
+	}
+}
+
+void ProtobufPlugin::apply_command(const NetworkCommand& command)
+{
+	String at = command.sampleNumber >= 0 ? " seen at sample " + String(command.sampleNumber)
+		+ " (arrived at " + String(command.arrivalSample) + ")" : String();
+
+	switch (command.type)
+	{
+	case NetworkCommand::STOP_ACQUISITION:
+		CoreServices::sendStatusMessage("Message: stop acquisition" + at + ".");
+		CoreServices::setAcquisitionStatus(false);
+		break;
+	case NetworkCommand::START_ACQUISITION:
+		CoreServices::sendStatusMessage("Message: start acquisition" + at + ".");
+		CoreServices::setAcquisitionStatus(true);
+		break;
+	case NetworkCommand::STOP_RECORDING:
+		CoreServices::sendStatusMessage("Message: stop recording" + at + ".");
+		CoreServices::setRecordingStatus(false);
+		break;
+	case NetworkCommand::START_RECORDING:
+		CoreServices::sendStatusMessage("Message: start recording" + at + ".");
+		CoreServices::setRecordingStatus(true);
+		break;
+	}
+}
+
+void ProtobufPlugin::handleAsyncUpdate()
+{
+	NetworkCommand command;
+
+	// commands that already passed through process()
+	while (appliedCommandQueue.pop(command))
+		apply_command(command);
+
+	// enable() and disable() also run on this thread, so while acquisition is
+	// stopped nothing else is consuming the command queue
+	if (!acquisitionActive)
+	{
+		while (commandQueue.pop(command))
+			apply_command(command);
+
+		apply_parameter_batches();
+	}
+}
+
+void ProtobufPlugin::handle_router_alive(const router_alive& alive)
+{
+	// confirmed once every subscribed id shows up in the router's registration list
+	for (int i = 0; i < dispatcher.getNumHandlers(); i++)
+	{
+		if (!dispatcher.isSubscribed(i))
+			continue;
+
+		const std::string& id = dispatcher.getMessageId(i);
+		bool found = false;
+
+		for (int j = 0; j < alive.registered_messages_size() && !found; j++)
+			found = (alive.registered_messages(j) == id);
+
+		if (!found)
+			return;
+	}
+
+	registration_confirmed();
+}
+
+void ProtobufPlugin::handle_remote_devices_list(const remote_devices_list& devices)
+{
+	if (registered || currentEndpoint != 0)
+		return;
+
+	// the router answers in order, so this reply means the registrations queued
+	// before its request reached it, unless the send queue gave up on any of them
+	const uint64 dropped = endpoints[0]->getSendQueue().getDroppedCount();
+
+	if (dropped == registrationDroppedCount)
+	{
+		registration_confirmed();
+		return;
+	}
+
+	std::cout << "Registrations with the router were dropped, registering again" << std::endl;
+	registrationDroppedCount = dropped;
+	register_endpoint_msgs(0);
+}
+
+void ProtobufPlugin::handle_remote_service_request(const remote_service_request& request)
+{
+	static const std::string id = "remote_service_reply";
+
+	const remote_service_request::COMMAND_TYPES command = request.command_type();
+
+	// setting parameters or starting acquisition twice because a client retried
+	// would be wrong; gets are harmless to repeat
+	if (command != remote_service_request::CMD_GET && command != remote_service_request::CMD_PLATFORM_INFO
+		&& is_retry(request.header(), std::hash<std::string>()(request.target() + '\0'
+			+ request.args() + '\0' + request.kwargs()) ^ uint64(command)))
+		return;
+
+	std::shared_ptr<const RemoteServiceTable> table;
+	{
+		const ScopedLock sl(lock);
+		table = serviceTable;
+	}
+
+	serviceArguments.parse(request.args(), request.kwargs());
+
+	std::string result;
+	bool processed = false;
+
+	if (table == nullptr)
+	{
+		result = "not in a signal chain";
+	}
+	else
+	{
+		switch (command)
+		{
+		case remote_service_request::CMD_SET:
+			processed = service_set(*table, request.target(), &result);
+			break;
+		case remote_service_request::CMD_GET:
+			processed = service_get(*table, request.target(), &result);
+			break;
+		case remote_service_request::CMD_RUN:
+		case remote_service_request::CMD_CALLABLE:
+			processed = service_run(*table, request, &result);
+			break;
+		case remote_service_request::CMD_PLATFORM_INFO:
+			result = "os=" + SystemStats::getOperatingSystemName().toStdString()
+				+ " host=" + SystemStats::getComputerName().toStdString();
+			processed = true;
+			break;
+		}
+	}
+
+	remote_service_reply& reply = replyPool.acquire<remote_service_reply>();
+	reply.set_call_result(processed ? remote_service_reply::RESULT_PROCESSED : remote_service_reply::RESULT_FAILED);
+	reply.set_reply(result);
+
+	send_reply(id, reply);
+}
+
+bool ProtobufPlugin::service_set(const RemoteServiceTable& table, const std::string& targets, std::string* result)
+{
+	// filled in place; left uncommitted if anything fails, so a batch is applied whole or not at all
+	ParameterBatch* batch = parameterQueue.beginPush();
+
+	if (batch == nullptr)
+	{
+		*result = "too many parameter changes waiting";
+		return false;
+	}
+
+	batch->numChanges = 0;
+
+	const std::string* channelText = serviceArguments.find("channel");
+	const int channel = channelText != nullptr ? atoi(channelText->c_str()) : -1;
+
+	auto add = [&](const std::string& name, const std::string& valueText) -> bool
+	{
+		const RemoteServiceTable::Target* target = table.find(name);
+		float value;
+
+		if (target == nullptr || target->kind != RemoteServiceTable::Target::PARAMETER)
+			*result = "unknown parameter " + name;
+		else if (!ServiceArguments::toFloat(valueText, &value))
+			*result = "bad value for " + name + ": " + valueText;
+		else if (batch->numChanges >= MAX_PARAMETER_CHANGES)
+			*result = "more than " + std::to_string(MAX_PARAMETER_CHANGES) + " parameters";
+		else
+		{
+			ParameterChange& change = batch->changes[batch->numChanges++];
+			change.processor = target->processor;
+			change.parameterIndex = target->parameterIndex;
+			change.channel = channel;
+			change.value = value;
+			return true;
+		}
+
+		return false;
+	};
+
+	// "a.x, b.y" with args "[1, 2]" (or one value for all), and/or kwargs {'a.x': 1}
+	const std::vector<std::string> names = ServiceArguments::splitList(targets);
+	const std::vector<std::string>& values = serviceArguments.args;
+
+	if (!names.empty() && values.size() != 1 && values.size() != names.size())
+	{
+		*result = "expected " + std::to_string(names.size()) + " values, got " + std::to_string(values.size());
+		return false;
+	}
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (!add(names[i], values.size() == 1 ? values[0] : values[i]))
+			return false;
+	}
+
+	for (const auto& kwarg : serviceArguments.kwargs)
+	{
+		if (kwarg.first != "channel" && !add(kwarg.first, kwarg.second))
+			return false;
+	}
+
+	if (batch->numChanges == 0)
+	{
+		*result = "no parameters given";
+		return false;
+	}
+
+	parameterQueue.commitPush();
+	*result = "queued " + std::to_string(batch->numChanges) + " parameter changes";
+
+	// process() isn't running to pick it up, so let the message thread do it
+	if (!acquisitionActive)
+		triggerAsyncUpdate();
+
+	return true;
+}
+
+bool ProtobufPlugin::service_get(const RemoteServiceTable& table, const std::string& targets, std::string* result)
+{
+	const std::string* channelText = serviceArguments.find("channel");
+	const int channel = channelText != nullptr ? atoi(channelText->c_str()) : 0;
+
+	result->clear();
+
+	for (const std::string& name : ServiceArguments::splitList(targets))
+	{
+		const RemoteServiceTable::Target* target = table.find(name);
+
+		if (target == nullptr || target->kind != RemoteServiceTable::Target::PARAMETER)
+		{
+			*result = "unknown parameter " + name;
+			return false;
+		}
+
+		Parameter* parameter = target->processor->getParameterObject(target->parameterIndex);
+
+		*result += (result->empty() ? "" : ", ") + name + "=" + parameter->getValue(channel).toString().toStdString();
+	}
+
+	return true;
+}
+
+bool ProtobufPlugin::service_run(const RemoteServiceTable& table, const remote_service_request& request, std::string* result)
+{
+	const RemoteServiceTable::Target* target = table.find(request.target());
+
+	if (target == nullptr || target->kind != RemoteServiceTable::Target::ACTION)
+	{
+		*result = "unknown action " + request.target();
+		return false;
+	}
+
+	post_command(NetworkCommand::Type(target->action), request.header());
+	*result = "queued " + request.target();
+	return true;
+}
+
+void ProtobufPlugin::apply_parameter_batches()
+{
+	ParameterBatch* batch;
+
+	while ((batch = parameterQueue.front()) != nullptr)
+	{
+		for (int i = 0; i < batch->numChanges; i++)
+		{
+			const ParameterChange& change = batch->changes[i];
+
+			if (change.channel >= 0)
+				change.processor->setCurrentChannel(change.channel);
+
+			change.processor->setParameter(change.parameterIndex, change.value);
+		}
+
+		parameterQueue.popFront();
+	}
+}
+
+void ProtobufPlugin::handle_set_data_file_path(const set_data_file_path& sdfp)
+{
+	if (is_retry(sdfp.header(), std::hash<std::string>()(sdfp.path())))
+		return;
+
+	CoreServices::sendStatusMessage(String("Message: set_data_file_path."));
+
+	const std::string path = sdfp.path();
+	const ReplyCache::Key key = currentRequestKey;
+	const int endpointIndex = currentEndpoint;
+	const std::string peer = endpointIndex >= 0 ? endpoints[endpointIndex]->getCurrentPeer() : std::string("router");
+
+	// creating the directory touches the filesystem, so it runs on a worker
+	// while this thread carries on answering status requests
+	executor.submit(client_key(sdfp.header()),
+		[path]
+		{
+			CoreServices::setRecordingDirectoryPrependText(String(path));
+			CoreServices::createNewRecordingDirectory();
+		},
+		[this, path, endpointIndex, peer, key]
+		{
+			static const std::string id = "system_status";
+			static const std::string source_id = "set_data_file_path";
+
+			system_status& status = replyPool.acquire<system_status>();
+			status.set_status(system_status_status_type_READY);
+			status.set_source_message_id(source_id);
+			status.set_message("path=" + path);
+
+			send_to_endpoint(endpointIndex, peer, id, serialize_msg(id, status));
+			replyCache.complete(key, id, replyBuffer);
+		});
+}
+
+void ProtobufPlugin::run()
+{
+	// # io = ZMQHandler(messages)
+	// 
+    String identitystring = String("OpenEphys_") + SystemStats::getComputerName();
+#ifdef WIN32
+    identitystring += "_" + String(_getpid());
+#endif
+
+	socketIdentity = identitystring.toStdString();
+	ioStartSeconds = float(ArrivalClock::secondsSinceOrigin());
+
+	// the primary router connection is required; the others are optional, and
+	// one that fails is left out of heartbeats and outgoing messages (and, having
+	// no socket, out of polling)
+	for (int i = 0; i < endpoints.size(); i++)
+	{
+		if (endpoints[i]->open(ZmqContext::get(), socketIdentity, SEND_HIGH_WATER_MARK))
+			continue;
+
+		if (i == 0)
+		{
+			endpoints[0]->close();
+			return;
+		}
+
+		CoreServices::sendStatusMessage("Protobuf: could not open endpoint " + String(endpoints[i]->getConfig().name));
+	}
+
+	std::vector<Endpoint*> sockets;
+
+	for (int i = 0; i < endpoints.size(); i++)
+		sockets.push_back(endpoints[i]);
+
+	EndpointPoller poller;
+	poller.build(sockets, &wakeup);
+
+	for (int i = 0; i < peers.size(); i++)
+		peers[i]->reset();
+
+	register_all_msgs();
+
+	// routers are expected to answer; other peers may legitimately stay quiet
+	timers.reset(endpoints.size());
+
+	for (int i = 0; i < endpoints.size() && heartbeatIntervalMs > 0; i++)
+	{
+		if (endpoints[i]->getConfig().type == ZMQ_ROUTER && !endpoints[i]->hasFailed())
+			timers.schedule(i, ArrivalClock::nowNanos() + int64(heartbeatIntervalMs) * 1000000);
+	}
+
+    threadRunning = true;
+
+	// frames are parsed straight out of the message ZMQ received, so payloads
+	// of any size and containing zero bytes arrive intact
+	Endpoint::MessageCallback callback = [this](const char* id, size_t idLength,
+		const void* data, size_t size, int64_t arrivalNanos)
+	{
+		int handlerIndex = dispatcher.find(id, idLength);
+		Endpoint* endpoint = endpoints[currentEndpoint];
+
+		// anything from the peer shows it's alive; only the probe's answer gives a round trip
+		peers[currentEndpoint]->heard(arrivalNanos,
+			handlerIndex == routerAliveHandler || handlerIndex == devicesListHandler);
+
+		if (!endpoint->accepts(handlerIndex))
+		{
+			endpoint->countRejected();
+			return;
+		}
+
+		handle_msg(handlerIndex, data, size, arrivalNanos);
+	};
+
+	std::vector<int> ready;
+	ready.reserve(sockets.size());
+	int replayWaitMs = -1;
+
+	while (!threadShouldExit())
+	{
+		// sleep until a message, a wakeup or, while replies are waiting on the
+		// high-water mark, the next retry
+		int timeout = getSendQueueDepth() > 0 ? 1 : -1;
+
+		if (replayWaitMs >= 0 && (timeout < 0 || replayWaitMs < timeout))
+			timeout = replayWaitMs;
+
+		const int timerWaitMs = timers.getTimeoutMs(ArrivalClock::nowNanos());
+
+		if (timerWaitMs >= 0 && (timeout < 0 || timerWaitMs < timeout))
+			timeout = timerWaitMs;
+
+		poller.poll(timeout, ready);
+
+		for (int index : ready)
+		{
+			currentEndpoint = index;
+			endpoints[index]->receive(callback);
+			currentEndpoint = -1;
+		}
+
+		executor.runCompletions();
+
+		timers.advance(ArrivalClock::nowNanos(), [this](int endpointIndex) { heartbeat(endpointIndex); });
+
+		service_replay_request();
+		replayWaitMs = replay_messages();
+
+		for (int i = 0; i < endpoints.size(); i++)
+			endpoints[i]->flush();
+    }
 
-    delete[] buffer;
     threadRunning = false;
 
-	zmq_close(router);
+	// finish slow commands so the ones queued behind them aren't lost
+	executor.waitUntilIdle();
+	executor.runCompletions();
+
+	for (int i = 0; i < endpoints.size(); i++)
+		endpoints[i]->close();
+
+	replayReader.close();
+	replaying = false;
 
     return;
 }
@@ -443,27 +1541,244 @@ void ProtobufPlugin::saveCustomParametersToXml(XmlElement* xml)
 {
     xml->setAttribute ("port", urlport);
     xml->setAttribute("url", url);
+    xml->setAttribute("heartbeat_ms", heartbeatIntervalMs.load());
+    xml->setAttribute("heartbeat_misses", maxMissedHeartbeats);
+
+    // one context serves every instance, so the last one saved wins
+    const ZmqContextSettings zmqSettings = ZmqContext::getSettings();
+    xml->setAttribute("zmq_io_threads", zmqSettings.ioThreads);
+    xml->setAttribute("zmq_max_sockets", zmqSettings.maxSockets);
+    xml->setAttribute("zmq_io_cpus", String(zmqSettings.cpusToString()));
+    xml->setAttribute("event_filter", messageEventFilter);
+    xml->setAttribute("stream_url", eventStreamUrl);
+    xml->setAttribute("stream_step", snippetStep);
+    xml->setAttribute("stream_channels", snippetChannels);
+    xml->setAttribute("capture_file", capture.isOpen() ? String(capture.getPath()) : String());
+
+    for (const EndpointConfig& config : extraEndpoints)
+    {
+        StringArray ids;
+
+        for (const std::string& id : config.messageIds)
+            ids.add(String(id));
+
+        XmlElement* child = xml->createNewChildElement("ENDPOINT");
+        child->setAttribute("name", String(config.name));
+        child->setAttribute("type", String(EndpointConfig::socketTypeName(config.type)));
+        child->setAttribute("url", String(config.url));
+        child->setAttribute("bind", config.bind);
+        child->setAttribute("messages", ids.joinIntoString(","));
+    }
 }
 
 
 void ProtobufPlugin::loadCustomParametersFromXml(XmlElement* xml)
 {
+    // only used if this instance is the one that creates the context, so this has
+    // to come before anything below that opens a socket (the event stream does)
+    ZmqContextSettings zmqSettings = ZmqContext::getSettings();
+    zmqSettings.ioThreads = jmax(1, xml->getIntAttribute("zmq_io_threads", zmqSettings.ioThreads));
+    zmqSettings.maxSockets = jmax(1, xml->getIntAttribute("zmq_max_sockets", zmqSettings.maxSockets));
+    zmqSettings.cpusFromString(xml->getStringAttribute("zmq_io_cpus", String(zmqSettings.cpusToString())).toStdString());
+    ZmqContext::configure(zmqSettings);
+
     url = xml->getStringAttribute("url");
+    setMessageEventFilter(xml->getStringAttribute("event_filter", messageEventFilter));
+    setSnippetDownsampling(xml->getIntAttribute("stream_step", snippetStep),
+                           xml->getIntAttribute("stream_channels", snippetChannels));
+    setEventStreamUrl(xml->getStringAttribute("stream_url", eventStreamUrl));
+    setHeartbeat(xml->getIntAttribute("heartbeat_ms", heartbeatIntervalMs),
+                 xml->getIntAttribute("heartbeat_misses", maxMissedHeartbeats));
+
+    String captureFile = xml->getStringAttribute("capture_file");
+
+    // a restored session captures to a new file beside the saved one, so the
+    // previous session's capture is kept rather than truncated
+    if (captureFile.isNotEmpty())
+        startCapture(File(captureFile).getNonexistentSibling().getFullPathName());
+
+    std::vector<EndpointConfig> configs;
+
+    forEachXmlChildElementWithTagName(*xml, child, "ENDPOINT")
+    {
+        EndpointConfig config;
+        config.name = child->getStringAttribute("name", "endpoint").toStdString();
+        config.type = EndpointConfig::socketTypeFromName(child->getStringAttribute("type").toUpperCase().toStdString());
+        config.url = child->getStringAttribute("url").toStdString();
+        config.bind = child->getBoolAttribute("bind", config.type == ZMQ_PUB);
+
+        if (config.type < 0 || config.url.empty())
+        {
+            std::cout << "Ignoring endpoint " << config.name << ": bad type or url" << std::endl;
+            continue;
+        }
+
+        StringArray ids;
+        ids.addTokens(child->getStringAttribute("messages"), ",", "");
+        ids.trim();
+        ids.removeEmptyStrings();
+
+        for (int i = 0; i < ids.size(); i++)
+            config.messageIds.push_back(ids[i].toStdString());
+
+        configs.push_back(config);
+    }
+
+    setExtraEndpoints(configs);
     setNewListeningPort (xml->getIntAttribute("port"));
 }
 
+void ProtobufPlugin::updateSettings()
+{
+    isEnabled = true;
+
+    // the chain may have changed, so index it afresh
+    std::shared_ptr<RemoteServiceTable> table = std::make_shared<RemoteServiceTable>();
+    table->build(this);
+    table->addAction("start_acquisition", NetworkCommand::START_ACQUISITION);
+    table->addAction("stop_acquisition", NetworkCommand::STOP_ACQUISITION);
+    table->addAction("start_recording", NetworkCommand::START_RECORDING);
+    table->addAction("stop_recording", NetworkCommand::STOP_RECORDING);
+
+    const ScopedLock sl(lock);
+    serviceTable = table;
+}
+
+void ProtobufPlugin::createEventChannels()
+{
+    float sampleRate = getNumInputs() > 0 ? getSampleRate(0) : CoreServices::getGlobalSampleRate();
+
+    for (int i = 0; i < NUM_MESSAGE_CHANNELS; i++)
+    {
+        EventChannel* chan = new EventChannel(EventChannel::UINT8_ARRAY, 1, MESSAGE_CHANNEL_SIZES[i], sampleRate, this);
+        chan->setName("Protobuf messages up to " + String(MESSAGE_CHANNEL_SIZES[i]) + " bytes");
+        chan->setDescription("Raw payloads of protobuf messages received by the Protobuf module; messages over "
+            + String(MAX_EVENT_PAYLOAD) + " bytes are not recorded");
+        chan->setIdentifier("external.protobuf.rawMessage");
+        chan->addEventMetaData(new MetaDataDescriptor(MetaDataDescriptor::INT64, 1, "Arrival time",
+            "Monotonic host time in nanoseconds when the message was received", "timestamp.software"));
+        chan->addEventMetaData(new MetaDataDescriptor(MetaDataDescriptor::UINT32, 1, "Payload length",
+            "Number of valid bytes in the event data", "protobuf.length"));
+        chan->addEventMetaData(new MetaDataDescriptor(MetaDataDescriptor::CHAR, MAX_MESSAGE_ID_LENGTH, "Message id",
+            "Message id the payload was received with", "protobuf.messageid"));
+        eventChannelArray.add(chan);
+        messageChannels[i] = chan;
+    }
+
+    messageEventMetaData.clear();
+    messageEventMetaData.add(new MetaDataValue(MetaDataDescriptor::INT64, 1));
+    messageEventMetaData.add(new MetaDataValue(MetaDataDescriptor::UINT32, 1));
+    messageEventMetaData.add(new MetaDataValue(MetaDataDescriptor::CHAR, MAX_MESSAGE_ID_LENGTH));
+}
+
+bool ProtobufPlugin::enable()
+{
+    // the sample counter restarts with acquisition
+    arrivalClock.reset();
+    acquisitionActive = true;
+    return isEnabled;
+}
+
+bool ProtobufPlugin::disable()
+{
+    // process() has stopped, so the message thread owns the command queue again
+    acquisitionActive = false;
+
+    // events left over can't be timestamped any more; the ZMQ thread stops
+    // producing them once acquisitionActive is cleared
+    while (messageEventQueue.front() != nullptr)
+        messageEventQueue.popFront();
+
+    if (eventStreamRestartPending)
+        restart_event_stream();
+
+    triggerAsyncUpdate();
+    return true;
+}
+
 void ProtobufPlugin::process(AudioBuffer<float>& buffer)
 {
+    int64 blockStart = getNumInputs() > 0 ? int64(getTimestamp(0)) : CoreServices::getGlobalTimestamp();
+    int numSamples = getNumInputs() > 0 ? int(getNumSamples(0)) : buffer.getNumSamples();
+
+    // the newest sample of this block has only just been acquired
+    arrivalClock.addSyncPoint(ArrivalClock::nowNanos(), blockStart + numSamples);
+
+    // processors downstream see a batch from this block on, upstream ones from the next
+    if (!parameterQueue.isEmpty())
+        apply_parameter_batches();
+
+    if (eventStream.isRunning())
+    {
+        checkForEvents(true);
+        add_snippets(buffer, blockStart, numSamples);
+        eventStream.endBlock();
+    }
+
+    if (commandQueue.isEmpty() && messageEventQueue.isEmpty())
+        return;
 
+    add_message_events(blockStart);
+
+    if (commandQueue.isEmpty())
+        return;
+
+    NetworkCommand* command;
+
+    // a command only leaves the queue once the message thread is sure to get it;
+    // the rest wait for the next block
+    while ((command = commandQueue.front()) != nullptr)
+    {
+        NetworkCommand* seen = appliedCommandQueue.beginPush();
+
+        if (seen == nullptr)
+            break;
+
+        *seen = *command;
+        seen->sampleNumber = blockStart;
+        seen->arrivalSample = arrivalClock.toSampleNumber(command->arrivalNanos);
+
+        appliedCommandQueue.commitPush();
+        commandQueue.popFront();
+    }
+
+    triggerAsyncUpdate();
 }
 
 
-void ProtobufPlugin::createZmqContext()
+void ProtobufPlugin::handleEvent(const EventChannel* eventInfo, const MidiMessage& event, int samplePosition)
 {
-	lock.enter();
-    if (zmqcontext == nullptr)
-        zmqcontext = zmq_ctx_new(); //<-- this is only available in version 3+
-	lock.exit();
+    if (Event::getEventType(event) != EventChannel::TTL)
+        return;
+
+    TTLEventPtr ttl = TTLEvent::deserializeFromMessage(event, eventInfo);
+    eventStream.addTtl(ttl->getTimestamp(), eventInfo->getSourceIndex(), ttl->getChannel(), ttl->getState());
+}
+
+void ProtobufPlugin::handleSpike(const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition)
+{
+    SpikeEventPtr spike = SpikeEvent::deserializeFromMessage(event, spikeInfo);
+    eventStream.addSpike(spike->getTimestamp(), spikeInfo->getSourceIndex(), spike->getSortedID());
+}
+
+void ProtobufPlugin::add_snippets(AudioBuffer<float>& buffer, int64 blockStart, int numSamples)
+{
+    if (snippetStep <= 0)
+        return;
+
+    const int step = snippetStep;
+    const int numChannels = jmin(snippetChannels, buffer.getNumChannels());
+
+    // keep the kept samples on multiples of step across block boundaries
+    const int first = int((step - blockStart % step) % step);
+
+    if (first >= numSamples)
+        return;
+
+    const int count = (numSamples - 1 - first) / step + 1;
+
+    for (int ch = 0; ch < numChannels; ch++)
+        eventStream.addSnippet(uint32(ch), blockStart + first, uint32(step), buffer.getReadPointer(ch) + first, count);
 }
 
 
@@ -31,9 +31,81 @@
 
 #include "resources/ephys_edi.pb.h"
 
+#include "ArrivalClock.h"
+#include "CaptureFile.h"
+#include "CommandExecutor.h"
+#include "Endpoint.h"
+#include "EventStream.h"
+#include "HeaderTemplate.h"
+#include "MessageDispatcher.h"
+#include "MessagePool.h"
+#include "OutboundQueue.h"
+#include "PeerLiveness.h"
+#include "PluginMetrics.h"
+#include "RemoteService.h"
+#include "ReplyCache.h"
+#include "WakeupChannel.h"
+#include "ZmqContext.h"
+#include "SpscQueue.h"
+#include "TimerWheel.h"
+
 #include <list>
 #include <queue>
 
+/**
+ A state change requested over the network.
+
+ While acquiring, process() stamps it with the block it was seen in and passes it
+ on; the GUI calls that change the state can only be made on the message thread,
+ so it takes effect a little later than that block.
+*/
+struct NetworkCommand
+{
+    enum Type
+    {
+        START_ACQUISITION,
+        STOP_ACQUISITION,
+        START_RECORDING,
+        STOP_RECORDING
+    };
+
+    Type type;
+
+    /** Host time the command was received, from ArrivalClock::nowNanos() */
+    int64 arrivalNanos;
+
+    /** Sample number the command arrived at, or -1 if acquisition was stopped */
+    int64 arrivalSample;
+
+    /** First sample of the block process() saw the command in, or -1 if acquisition was stopped */
+    int64 sampleNumber;
+};
+
+/** Largest message payload that is forwarded to the event channels */
+const int MAX_EVENT_PAYLOAD = 2048;
+
+/** An event channel's data size is fixed, so there is one channel per size; each
+    message goes out on the smallest that holds it */
+const int NUM_MESSAGE_CHANNELS = 4;
+const int MESSAGE_CHANNEL_SIZES[NUM_MESSAGE_CHANNELS] = { 64, 256, 1024, MAX_EVENT_PAYLOAD };
+
+/**
+ A received message waiting to be added to the event channel by process()
+*/
+struct MessageEvent
+{
+    int handlerIndex;
+
+    /** Host time the message was received, from ArrivalClock::nowNanos() */
+    int64 arrivalNanos;
+
+    uint32 size;
+
+    /** Index into MESSAGE_CHANNEL_SIZES; the payload is zero-padded to that size */
+    int channelIndex;
+    uint8 payload[MAX_EVENT_PAYLOAD];
+};
+
 /**
  Sends incoming TCP/IP messages from 0MQ to the events buffer
 
@@ -41,6 +113,7 @@
 */
 class ProtobufPlugin : public GenericProcessor
                     , public Thread
+                    , public AsyncUpdater
 {
 public:
     
@@ -53,11 +126,30 @@ public:
     /** Create editor */
     AudioProcessorEditor* createEditor() override;
 
-    /** Process method (not used) */
+    /** Applies queued network commands at the block boundary */
     void process (AudioBuffer<float>& buffer) override;
+
+    /** Queue TTL events for the event stream */
+    void handleEvent (const EventChannel* eventInfo, const MidiMessage& event, int samplePosition) override;
+
+    /** Queue spikes for the event stream */
+    void handleSpike (const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition) override;
     
-    /** Set isEnabled to "true" if a connection was made*/
+    /** Enable the processor so process() runs during acquisition, and index the chain's
+        parameters for remote_service_request */
     void updateSettings() override;
+
+    /** Create the channel received messages are sent to */
+    void createEventChannels() override;
+
+    /** Hand the command queue to process() for the duration of acquisition */
+    bool enable() override;
+
+    /** Take the command queue back from process() once acquisition has stopped */
+    bool disable() override;
+
+    /** Apply commands on the message thread */
+    void handleAsyncUpdate() override;
     
     /** Save URL and port */
     void saveCustomParametersToXml (XmlElement* xml) override;
@@ -79,12 +171,83 @@ public:
     
     /** Set listening URL (called by editor) */
     String getListeningUrl ();
+
+    /** Set which message ids are added to the event channel: a comma-separated list, or "*" for all */
+    void setMessageEventFilter(String filter);
+
+    /** Get the message event filter */
+    String getMessageEventFilter();
+
+    /** Publish TTL events and spikes on a PUB socket bound to this URL; empty to stop.
+        Takes effect once acquisition has stopped. */
+    void setEventStreamUrl(String url);
+
+    /** Get the event stream URL */
+    String getEventStreamUrl();
+
+    /** Also publish every step-th sample of the first numChannels continuous channels; 0 to stop */
+    void setSnippetDownsampling(int step, int numChannels);
+
+    /** Record every message sent and received to a capture file */
+    bool startCapture(String path);
+
+    /** Finish the capture file */
+    void stopCapture();
+
+    bool isCapturing() const;
+
+    /** Feed the received messages of a capture file to the handlers, at the pace they
+        were captured or as fast as possible */
+    void startReplay(String path, bool realTime);
+
+    /** Stop a replay early */
+    void stopReplay();
+
+    bool isReplaying() const;
+
+    /** Sample number a host time from ArrivalClock::nowNanos() lines up with, or -1 if not acquiring */
+    int64 getArrivalSampleNumber(int64 hostNanos) const;
+
+    /** Sample number the most recent message arrived at, or -1 if not acquiring */
+    int64 getLastArrivalSampleNumber() const;
+
+    /** Number of replies waiting to be sent, over all endpoints */
+    int getSendQueueDepth() const;
+
+    /** Number of replies dropped because a send queue was full, over all endpoints */
+    uint64 getDroppedSendCount() const;
+
+    /** Number of messages left off the event channels, because the queue to process() was
+        full or the payload was over MAX_EVENT_PAYLOAD */
+    uint64 getDroppedMessageEventCount() const;
+
+    /** Endpoints besides the primary router connection (applied the next time the socket is opened) */
+    void setExtraEndpoints(const std::vector<EndpointConfig>& configs);
+    const std::vector<EndpointConfig>& getExtraEndpoints() const;
+
+    /** Send a heartbeat to each router every intervalMs (0 for none) and reconnect after
+        maxMisses in a row go unanswered. Takes effect the next time the socket is opened. */
+    void setHeartbeat(int intervalMs, int maxMisses);
+    int getHeartbeatIntervalMs() const;
+    int getMaxMissedHeartbeats() const;
+
+    /** Liveness of the primary router connection (read by the editor), or nullptr if not connected */
+    const PeerLiveness* getRouterLiveness() const;
+
+    /** Hot-path counters (read by the editor) */
+    const PluginMetrics& getMetrics() const;
+
+    /** Counters as the JSON sent in reply to request_metrics */
+    std::string getMetricsJson() const;
+
+    /** True once the router has confirmed our message registrations */
+    bool isRegistered() const;
+
+    /** Time from connecting to confirmed registration, in milliseconds */
+    double getTimeToReadyMs() const;
     
 private:
     
-    /** Creates the ZMQ context */
-    void createZmqContext();
-    
     /** Split string based on separators */
     std::vector<String> splitString (String S, char sep);
     
@@ -95,31 +258,212 @@ private:
     void opensocket();
     bool closesocket();
     
+    /** Fill the dispatch table with one entry per supported message type */
+    void registerHandlers();
+
+    /** Build the endpoint list from the URL, port and extra endpoints (socket thread stopped) */
+    void createEndpoints();
+
     /** ZMQ message functions */
-    void register_for_msg(String message_id);
-    void handle_msg(std::string msg, String message_id);
-    void send_multipart_msg(std::string part1, std::string part2, std::string part3);
-    void generate_msg_header(message_header* header, String id);
+    void register_for_msg(Endpoint* endpoint, String message_id);
+    void register_all_msgs();
+    void register_endpoint_msgs(int endpointIndex);
+    void registration_confirmed();
+    void handle_msg(int handlerIndex, const void* msg, size_t size, int64 arrivalNanos);
+    void send_multipart_msg(const std::string& part1, const std::string& part2, const std::string& part3);
+
+    /** Send on a given endpoint (the primary router if it can't take replies) */
+    void send_to_endpoint(int endpointIndex, const std::string& peer, const std::string& id, const std::string& payload);
+
+    /** Serialize a message with a header for id into the reused buffer (I/O thread) */
+    const std::string& serialize_msg(const std::string& id, const google::protobuf::Message& message);
+
+    /** Serialize a reply and send it to the router (I/O thread) */
+    void send_reply(const std::string& id, const google::protobuf::Message& reply);
+    /** True if the request was already handled, in which case its cached reply (if any) has been
+        re-sent; otherwise it is recorded and the next reply sent is cached for it. Requests whose
+        header carries no request id are never treated as retries (I/O thread) */
+    bool is_retry(const message_header& header, uint64 discriminator);
+    /** Send a system_status acknowledging a command */
+    void send_command_status(const std::string& sourceId, const std::string& text);
+
+    /** Message handlers */
+    void handle_request_system_info(const request_system_info& rsi);
+    void handle_request_system_status(const request_system_status& rss);
+    void handle_request_metrics(const request_system_status& request);
+    void handle_acquisition(const acquisition& acq);
+    void handle_recording(const recording& rec);
+    void handle_set_data_file_path(const set_data_file_path& sdfp);
+    void handle_router_alive(const router_alive& alive);
+    void handle_remote_devices_list(const remote_devices_list& devices);
+    void handle_remote_service_request(const remote_service_request& request);
+
+    /** remote_service_request commands; each returns false with the reason in result if it failed */
+    bool service_set(const RemoteServiceTable& table, const std::string& targets, std::string* result);
+    bool service_get(const RemoteServiceTable& table, const std::string& targets, std::string* result);
+    bool service_run(const RemoteServiceTable& table, const remote_service_request& request, std::string* result);
+
+    /** Set the parameters of queued remote_service_request batches (process() while acquiring,
+        the message thread otherwise) */
+    void apply_parameter_batches();
+
+    /** Queue a command for the processing thread, behind any slow commands from the same client (called from the ZMQ thread) */
+    void post_command(NetworkCommand::Type type, const message_header& header);
+    void queue_command(NetworkCommand::Type type, int64 arrivalNanos);
+
+    /** Heartbeat timer for an endpoint fired: count a miss or send the next heartbeat (I/O thread) */
+    void heartbeat(int endpointIndex);
+    /** Replace the socket of an endpoint whose peer stopped answering and register again (I/O thread) */
+    void reconnect_endpoint(int endpointIndex);
+
+    /** Who sent a message, for keeping each client's commands in order */
+    static std::string client_key(const message_header& header);
+
+    /** Handler index of the message currently being handled, -1 outside handlers */
+    int currentHandler;
+
+    /** Endpoint the message currently being handled arrived on, -1 outside handlers */
+    int currentEndpoint;
+    /** Replies to recent commands, re-sent when a client retries (I/O thread) */
+    ReplyCache replyCache;
+    /** Set while handling a command whose reply goes in the cache */
+    bool currentRequestCached;
+    ReplyCache::Key currentRequestKey;
+
+    PluginMetrics metrics;
+
+    /** Arrival time of the message currently being handled */
+    int64 currentArrivalNanos;
+    std::atomic<int64> lastArrivalNanos;
+
+    /** Host clock to sample clock mapping, updated every block */
+    ArrivalClock arrivalClock;
+
+    /** Carry out a command on the message thread */
+    void apply_command(const NetworkCommand& command);
+
+    /** Open or close the replay file as requested by the message thread (ZMQ thread) */
+    void service_replay_request();
+
+    /** Handle the replayed messages that are due; returns how long to wait for the next one,
+        in ms, or -1 if not replaying (ZMQ thread) */
+    int replay_messages();
+
+    /** Copy a received message into the event ring if its id passes the filter (called from the ZMQ thread) */
+    void post_message_event(int handlerIndex, const void* msg, size_t size, int64 arrivalNanos);
+
+    /** Add queued message events to the event channel (called from process()) */
+    void add_message_events(int64 blockStart);
+
+    /** (Re)start the event stream on eventStreamUrl (socket threads idle or stopped) */
+    void restart_event_stream();
+
+    /** Queue downsampled continuous data for the event stream (called from process()) */
+    void add_snippets(AudioBuffer<float>& buffer, int64 blockStart, int numSamples);
     
     int urlport;
     String url;
     String socketStatus;
     std::atomic<bool> threadRunning;
 
-    register_for_message message;
+    std::atomic<bool> registered;
+    int64 registrationStartTicks;
+
+    /** The primary endpoint's dropped send count when its registrations were queued */
+    uint64 registrationDroppedCount;
+
+    std::atomic<double> timeToReadyMs;
+
+    MessageDispatcher dispatcher;
+
+    /** Replies built by the I/O thread, reused from message to message */
+    MessagePool replyPool;
+    std::string replyBuffer;
+
+    /** The constant part of every message header */
+    HeaderTemplate headerTemplate;
+
+
+    /** The router connection built from url and urlport comes first */
+    OwnedArray<Endpoint> endpoints;
+    std::vector<EndpointConfig> extraEndpoints;
 
-    static void* zmqcontext;
-    void* router;
+    /** Liveness of each endpoint's peer, parallel to endpoints (heartbeats go to ROUTER endpoints only) */
+    OwnedArray<PeerLiveness> peers;
+    /** One heartbeat timer per endpoint (I/O thread) */
+    TimerWheel timers;
+    std::atomic<int> heartbeatIntervalMs;
+    int maxMissedHeartbeats;
+    /** Answers to the heartbeat probe */
+    int routerAliveHandler;
+    int devicesListHandler;
+    /** Socket identity and start time of the running I/O thread, for reconnects and heartbeats */
+    std::string socketIdentity;
+    float ioStartSeconds;
+    /** Wakes the I/O thread for sends, reconfiguration and shutdown */
+    WakeupChannel wakeup;
+
+    /** Runs slow commands off the I/O thread; completions run on the I/O thread */
+    CommandExecutor executor;
     bool state;
     bool shutdown;
     bool firstTime;
 
     Time timer;
 
-    std::queue<String> networkMessagesQueue;
+    /** ZMQ thread -> process() while acquiring, ZMQ thread -> message thread otherwise */
+    SpscQueue<NetworkCommand> commandQueue;
+
+    /** process() -> message thread, stamped with the sample number of the block they were seen in */
+    SpscQueue<NetworkCommand> appliedCommandQueue;
+
+    std::atomic<bool> acquisitionActive;
+
+    /** ZMQ thread -> process() while acquiring, ZMQ thread -> message thread otherwise */
+    SpscQueue<ParameterBatch> parameterQueue;
+    /** Targets of remote_service_request, swapped in whole under lock by updateSettings() */
+    std::shared_ptr<const RemoteServiceTable> serviceTable;
+    /** Arguments of the request being handled (ZMQ thread) */
+    ServiceArguments serviceArguments;
+    /** ZMQ thread -> process(): raw payloads of received messages */
+    SpscQueue<MessageEvent> messageEventQueue;
+
+    /** Bit n set if messages for handler n are added to the event channel */
+    std::atomic<uint64> messageEventMask;
+    String messageEventFilter;
+    std::atomic<uint64> droppedMessageEvents;
+    std::atomic<uint64> oversizedMessageEvents;
+
+    CaptureWriter capture;
+
+    /** Replay state, owned by the ZMQ thread */
+    CaptureReader replayReader;
+    CaptureRecord replayRecord;
+    bool replayHasRecord;
+    bool replayRealTime;
+    int64 replayOffsetNanos;
+    std::atomic<bool> replaying;
+
+    /** Replay start or stop handed to the ZMQ thread */
+    enum ReplayRequest { REPLAY_NONE, REPLAY_START, REPLAY_STOP };
+    std::atomic<int> replayRequest;
+    String replayPath;
+    bool replayRequestRealTime;
+
+    /** process() -> publishing thread */
+    EventStream eventStream;
+    String eventStreamUrl;
+    bool eventStreamRestartPending;
+    int snippetStep;
+    int snippetChannels;
+
+    /** Reused for every message event */
+    MetaDataValueArray messageEventMetaData;
+    StringArray messageIdNames;
+
     CriticalSection lock;
  
-	const EventChannel* messageChannel{ nullptr };
+	const EventChannel* messageChannels[NUM_MESSAGE_CHANNELS]{};
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProtobufPlugin);
 };
@@ -30,7 +30,7 @@ ProtobufPluginEditor::ProtobufPluginEditor(GenericProcessor* parentNode)
     : GenericEditor(parentNode)
 
 {
-	desiredWidth = 180;
+	desiredWidth = 320;
 
 	ProtobufPlugin *p = (ProtobufPlugin *)getProcessor();
 
@@ -65,6 +65,19 @@ ProtobufPluginEditor::ProtobufPluginEditor(GenericProcessor* parentNode)
 	urlEditor->addListener(this);
 	addAndMakeVisible(urlEditor);
 
+	metricsLabel = new Label("Metrics", "");
+	metricsLabel->setBounds(180, 28, 135, 95);
+	metricsLabel->setFont(Font("Small Text", 11, Font::plain));
+	metricsLabel->setColour(Label::textColourId, Colours::black);
+	addAndMakeVisible(metricsLabel);
+
+	livenessLabel = new Label("Liveness", "");
+	livenessLabel->setBounds(20, 48, 155, 16);
+	livenessLabel->setFont(Font("Small Text", 11, Font::plain));
+	livenessLabel->setColour(Label::textColourId, Colours::black);
+	addAndMakeVisible(livenessLabel);
+
+	startTimer(500);
 }
 
 void ProtobufPluginEditor::refreshValues()
@@ -76,6 +89,51 @@ void ProtobufPluginEditor::refreshValues()
 
 
 
+void ProtobufPluginEditor::timerCallback()
+{
+	ProtobufPlugin *p = (ProtobufPlugin *)getProcessor();
+	const PluginMetrics& m = p->getMetrics();
+
+	String text;
+	text += "Received: " + String((int64) m.totalReceived()) + "\n";
+	text += "Handled: " + String((int64) m.totalHandled()) + "\n";
+	text += "Parse errors: " + String((int64) m.totalParseFailures()) + "\n";
+	text += "Replies: " + String((int64) m.totalRepliesSent()) + "\n";
+	text += "Send queue: " + String(p->getSendQueueDepth())
+		+ " (" + String((int64) p->getDroppedSendCount()) + " dropped)\n";
+	text += "Events dropped: " + String((int64) p->getDroppedMessageEventCount()) + "\n";
+	text += "p99 handle: " + String(m.maxHandlePercentileNanos(0.99) / 1000.0, 1) + " us";
+
+	metricsLabel->setText(text, dontSendNotification);
+
+	// the URL and port boxes turn red when the router stops answering heartbeats
+	const PeerLiveness* router = p->getRouterLiveness();
+	String liveness = "Router: not connected";
+	Colour colour = Colours::grey;
+
+	if (router != nullptr)
+	{
+		liveness = "Router: " + String(PeerLiveness::stateName(router->getState()));
+
+		if (router->getSmoothedRttNanos() >= 0)
+			liveness += ", RTT " + String(router->getSmoothedRttNanos() / 1000000.0, 2) + " ms";
+
+		if (router->getMisses() > 0)
+			liveness += " (" + String(router->getMisses()) + " missed)";
+
+		switch (router->getState())
+		{
+		case PeerLiveness::ALIVE:   colour = Colours::green; break;
+		case PeerLiveness::SUSPECT: colour = Colours::orange; break;
+		case PeerLiveness::DEAD:    colour = Colours::red; break;
+		default:                    break;
+		}
+	}
+
+	livenessLabel->setText(liveness, dontSendNotification);
+	setLabelColor(colour);
+}
+
 void ProtobufPluginEditor::buttonClicked(Button* button)
 {
 	if (button == restartConnection)
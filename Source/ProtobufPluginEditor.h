@@ -41,7 +41,8 @@ class ProtobufPlugin;
 class ProtobufPluginEditor :
     public GenericEditor,
     public Button::Listener,
-    public Label::Listener
+    public Label::Listener,
+    public Timer
 {
 public:
     
@@ -49,7 +50,7 @@ public:
 	ProtobufPluginEditor(GenericProcessor* parentNode);
     
     /** Destructor */
-    virtual ~ProtobufPluginEditor() { }
+    virtual ~ProtobufPluginEditor() { stopTimer(); }
 
     /** Respond to button clicks*/
     void buttonClicked(Button* button);
@@ -62,6 +63,9 @@ public:
 
     /** Set URL and port numbers*/
 	void refreshValues();
+
+    /** Refresh the metrics panel */
+	void timerCallback();
 private:
 
 	ScopedPointer<UtilityButton> restartConnection;
@@ -69,6 +73,8 @@ private:
 	ScopedPointer<Label> portEditor;
 	ScopedPointer<Label> urlLabel;
 	ScopedPointer<Label> urlEditor;
+	ScopedPointer<Label> metricsLabel;
+	ScopedPointer<Label> livenessLabel;
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProtobufPluginEditor);
 
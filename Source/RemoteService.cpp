@@ -0,0 +1,197 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RemoteService.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    /** Trim whitespace and any of the given bracket or quote characters from both ends */
+    std::string strip (const std::string& text, const char* characters)
+    {
+        size_t begin = 0;
+        size_t end = text.length();
+
+        while (begin < end && (isspace ((unsigned char) text[begin]) || strchr (characters, text[begin]) != nullptr))
+            begin++;
+
+        while (end > begin && (isspace ((unsigned char) text[end - 1]) || strchr (characters, text[end - 1]) != nullptr))
+            end--;
+
+        return text.substr (begin, end - begin);
+    }
+}
+
+std::vector<std::string> ServiceArguments::splitList (const std::string& text)
+{
+    std::vector<std::string> items;
+    const std::string inner = strip (text, "[](){}");
+    size_t start = 0;
+
+    while (start <= inner.length() && ! inner.empty())
+    {
+        size_t comma = inner.find (',', start);
+
+        if (comma == std::string::npos)
+            comma = inner.length();
+
+        const std::string item = strip (inner.substr (start, comma - start), "");
+
+        if (! item.empty())
+            items.push_back (item);
+
+        start = comma + 1;
+    }
+
+    return items;
+}
+
+void ServiceArguments::parse (const std::string& argString, const std::string& kwargString)
+{
+    args.clear();
+    kwargs.clear();
+
+    for (const std::string& item : splitList (argString))
+        args.push_back (strip (item, "'\""));
+
+    for (const std::string& item : splitList (kwargString))
+    {
+        size_t separator = item.find_first_of (":=");
+
+        if (separator == std::string::npos)
+            continue;
+
+        kwargs.push_back (std::make_pair (strip (item.substr (0, separator), "'\""),
+                                          strip (item.substr (separator + 1), "'\"")));
+    }
+}
+
+const std::string* ServiceArguments::find (const std::string& key) const
+{
+    for (const auto& kwarg : kwargs)
+    {
+        if (kwarg.first == key)
+            return &kwarg.second;
+    }
+
+    return nullptr;
+}
+
+bool ServiceArguments::toFloat (const std::string& text, float* value)
+{
+    if (text == "true" || text == "True")
+    {
+        *value = 1.0f;
+        return true;
+    }
+
+    if (text == "false" || text == "False")
+    {
+        *value = 0.0f;
+        return true;
+    }
+
+    char* end = nullptr;
+    const double number = strtod (text.c_str(), &end);
+
+    if (text.empty() || *end != '\0')
+        return false;
+
+    *value = float (number);
+    return true;
+}
+
+void RemoteServiceTable::build (GenericProcessor* self)
+{
+    targets.clear();
+
+    std::vector<GenericProcessor*> upstream;
+
+    for (GenericProcessor* p = self->getSourceNode(); p != nullptr; p = p->getSourceNode())
+        upstream.push_back (p);
+
+    // upstream first, from the source on, so shared names go to the earliest processor
+    for (auto p = upstream.rbegin(); p != upstream.rend(); ++p)
+        addProcessor (*p);
+
+    addProcessor (self);
+
+    for (GenericProcessor* p = self->getDestNode(); p != nullptr; p = p->getDestNode())
+        addProcessor (p);
+}
+
+void RemoteServiceTable::addAction (const std::string& name, int action)
+{
+    Target target;
+    target.kind = Target::ACTION;
+    target.processor = nullptr;
+    target.parameterIndex = -1;
+    target.action = action;
+
+    targets[normalise (name)] = target;
+}
+
+const RemoteServiceTable::Target* RemoteServiceTable::find (const std::string& name) const
+{
+    auto it = targets.find (normalise (name));
+
+    return it != targets.end() ? &it->second : nullptr;
+}
+
+void RemoteServiceTable::addProcessor (GenericProcessor* processor)
+{
+    const std::string nodeId = std::to_string (processor->getNodeId());
+    const std::string processorName = normalise (processor->getName().toStdString());
+
+    for (int i = 0; i < processor->getNumParameters(); i++)
+    {
+        Parameter* parameter = processor->getParameterObject (i);
+
+        if (parameter == nullptr)
+            continue;
+
+        Target target;
+        target.kind = Target::PARAMETER;
+        target.processor = processor;
+        target.parameterIndex = i;
+        target.action = -1;
+
+        const std::string parameterName = normalise (parameter->getName().toStdString());
+
+        targets[nodeId + "." + parameterName] = target;
+        targets.insert (std::make_pair (processorName + "." + parameterName, target));
+    }
+}
+
+std::string RemoteServiceTable::normalise (const std::string& name)
+{
+    std::string key = name;
+
+    for (char& c : key)
+        c = c == ' ' ? '_' : char (tolower ((unsigned char) c));
+
+    return key;
+}
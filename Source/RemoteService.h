@@ -0,0 +1,128 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __REMOTESERVICE_H_4E7B2D58__
+#define __REMOTESERVICE_H_4E7B2D58__
+
+#include <ProcessorHeaders.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** Most parameter changes one remote_service_request can carry */
+const int MAX_PARAMETER_CHANGES = 32;
+
+/**
+ One parameter to set on a processor in the signal chain.
+*/
+struct ParameterChange
+{
+    GenericProcessor* processor;
+    int parameterIndex;
+    /** Channel to select first, or -1 to leave the processor's current channel */
+    int channel;
+    float value;
+};
+
+/**
+ The parameter changes of one request, applied together at a block boundary.
+*/
+struct ParameterBatch
+{
+    int numChanges;
+    ParameterChange changes[MAX_PARAMETER_CHANGES];
+};
+
+/**
+ The positional and keyword arguments of a remote_service_request.
+
+ The router passes them on as the client wrote them, usually Python literals
+ such as "[0.5, 2]" and "{'channel': 3}"; "0.5, 2" and "channel=3" are
+ accepted too. Values are split on commas, so they can't contain any.
+*/
+struct ServiceArguments
+{
+    std::vector<std::string> args;
+    std::vector<std::pair<std::string, std::string>> kwargs;
+
+    /** Split args and kwargs into values */
+    void parse (const std::string& argString, const std::string& kwargString);
+
+    /** Value of a keyword argument, or nullptr */
+    const std::string* find (const std::string& key) const;
+
+    /** Split a comma-separated list, dropping surrounding brackets, whitespace and empty items */
+    static std::vector<std::string> splitList (const std::string& text);
+
+    /** Number a value holds ("true" and "false" count as 1 and 0); false if it holds none */
+    static bool toFloat (const std::string& text, float* value);
+};
+
+/**
+ What the targets of remote_service_request resolve to.
+
+ Every parameter of every processor in the plugin's signal chain is listed
+ under "<node id>.<parameter>" and "<processor name>.<parameter>", lower case
+ with spaces turned into underscores; if two processors share a name, the
+ first one upstream gets the name key. Actions are listed under their own
+ names. The table is rebuilt whenever the chain's settings change and
+ swapped in whole, so the I/O thread always sees a consistent one.
+*/
+class RemoteServiceTable
+{
+public:
+
+    struct Target
+    {
+        enum Kind { PARAMETER, ACTION };
+
+        Kind kind;
+        GenericProcessor* processor;
+        int parameterIndex;
+        /** Caller-defined action number */
+        int action;
+    };
+
+    /** Index the parameters of the processors upstream and downstream of self */
+    void build (GenericProcessor* self);
+
+    /** Make name resolve to an action */
+    void addAction (const std::string& name, int action);
+
+    /** Look up a target; case-insensitive. Returns nullptr if unknown. */
+    const Target* find (const std::string& name) const;
+
+    int getNumTargets() const { return int (targets.size()); }
+
+private:
+
+    void addProcessor (GenericProcessor* processor);
+
+    static std::string normalise (const std::string& name);
+
+    std::unordered_map<std::string, Target> targets;
+};
+
+#endif  // __REMOTESERVICE_H_4E7B2D58__
@@ -0,0 +1,273 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ReplyCache.h"
+
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    uint64_t fnv1a (uint64_t h, const void* data, size_t length)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*> (data);
+
+        for (size_t i = 0; i < length; i++)
+        {
+            h ^= bytes[i];
+            h *= 1099511628211ull;
+        }
+
+        return h;
+    }
+
+    uint64_t mix (uint64_t h)
+    {
+        // splitmix64 finalizer
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        return h ^ (h >> 31);
+    }
+
+    uint64_t hashFields (uint64_t seed, const std::string& host, const std::string& process,
+                         uint64_t requestId, uint64_t discriminator)
+    {
+        // lengths go in too, so ("ab", "c") and ("a", "bc") differ
+        uint64_t h = seed;
+
+        for (const std::string* field : { &host, &process })
+        {
+            const uint64_t length = field->length();
+            h = fnv1a (h, &length, sizeof (length));
+            h = fnv1a (h, field->data(), field->length());
+        }
+
+        h = fnv1a (h, &requestId, sizeof (requestId));
+        h = fnv1a (h, &discriminator, sizeof (discriminator));
+
+        return mix (h);
+    }
+}
+
+ReplyCache::ReplyCache (int capacity_, int64_t retryWindowNanos_)
+    : capacity          (capacity_ > 0 ? capacity_ : 1)
+    , count             (0)
+    , retryWindowNanos  (retryWindowNanos_)
+    , head              (-1)
+    , tail              (-1)
+    , hitCount          (0)
+    , pendingHitCount   (0)
+    , missCount         (0)
+    , evictionCount     (0)
+{
+    // at most half full, so probe runs stay short
+    size_t numSlots = 1;
+
+    while (numSlots < size_t (capacity) * 2)
+        numSlots <<= 1;
+
+    slots.resize (numSlots);
+    slotMask = uint32_t (numSlots - 1);
+
+    for (Slot& slot : slots)
+    {
+        slot.used = false;
+        slot.pending = false;
+        slot.insertedNanos = 0;
+        slot.prev = -1;
+        slot.next = -1;
+    }
+}
+
+ReplyCache::Key ReplyCache::makeKey (const std::string& host, const std::string& process,
+                                     uint64_t requestId, uint64_t discriminator)
+{
+    // two independent hashes: one places the entry, both have to match
+    Key key;
+    key.hash = hashFields (14695981039346656037ull, host, process, requestId, discriminator);
+    key.check = hashFields (0x9e3779b97f4a7c15ull, host, process, requestId, discriminator);
+    return key;
+}
+
+ReplyCache::Result ReplyCache::lookup (const Key& key, int64_t nowNanos, const std::string** id, const std::string** reply)
+{
+    const int slot = find (key);
+
+    if (slot < 0 || nowNanos - slots[slot].insertedNanos > retryWindowNanos)
+    {
+        missCount++;
+        return MISS;
+    }
+
+    unlink (slot);
+    pushFront (slot);
+
+    if (slots[slot].pending)
+    {
+        pendingHitCount++;
+        return PENDING;
+    }
+
+    hitCount++;
+    *id = &slots[slot].id;
+    *reply = &slots[slot].reply;
+    return HIT;
+}
+
+void ReplyCache::insert (const Key& key, int64_t nowNanos)
+{
+    int slot = find (key);
+
+    if (slot >= 0)
+    {
+        // an expired entry for the same request: start it over
+        unlink (slot);
+    }
+    else
+    {
+        if (count >= capacity)
+        {
+            remove (tail);
+            evictionCount++;
+        }
+
+        slot = int (key.hash & slotMask);
+
+        while (slots[slot].used)
+            slot = int ((slot + 1) & slotMask);
+
+        slots[slot].used = true;
+        slots[slot].key = key;
+        count++;
+    }
+
+    // the strings keep their buffers for the next reply stored here
+    slots[slot].pending = true;
+    slots[slot].insertedNanos = nowNanos;
+    slots[slot].id.clear();
+    slots[slot].reply.clear();
+
+    pushFront (slot);
+}
+
+void ReplyCache::complete (const Key& key, const std::string& id, const std::string& reply)
+{
+    const int slot = find (key);
+
+    if (slot < 0)
+        return;
+
+    slots[slot].pending = false;
+    slots[slot].id.assign (id);
+    slots[slot].reply.assign (reply);
+}
+
+int ReplyCache::find (const Key& key) const
+{
+    uint32_t slot = uint32_t (key.hash) & slotMask;
+
+    while (slots[slot].used)
+    {
+        if (slots[slot].key.hash == key.hash && slots[slot].key.check == key.check)
+            return int (slot);
+
+        slot = (slot + 1) & slotMask;
+    }
+
+    return -1;
+}
+
+void ReplyCache::unlink (int slot)
+{
+    Slot& s = slots[slot];
+
+    if (s.prev >= 0)
+        slots[s.prev].next = s.next;
+    else
+        head = s.next;
+
+    if (s.next >= 0)
+        slots[s.next].prev = s.prev;
+    else
+        tail = s.prev;
+
+    s.prev = -1;
+    s.next = -1;
+}
+
+void ReplyCache::pushFront (int slot)
+{
+    slots[slot].prev = -1;
+    slots[slot].next = head;
+
+    if (head >= 0)
+        slots[head].prev = slot;
+    else
+        tail = slot;
+
+    head = slot;
+}
+
+void ReplyCache::remove (int slot)
+{
+    unlink (slot);
+    slots[slot].used = false;
+    count--;
+
+    uint32_t hole = uint32_t (slot);
+    uint32_t next = hole;
+
+    while (true)
+    {
+        next = (next + 1) & slotMask;
+
+        if (! slots[next].used)
+            break;
+
+        // an entry whose home slot lies cyclically in (hole, next] is still reachable
+        const uint32_t home = uint32_t (slots[next].key.hash) & slotMask;
+        const bool reachable = hole <= next ? (hole < home && home <= next)
+                                            : (hole < home || home <= next);
+
+        if (reachable)
+            continue;
+
+        // move it into the hole; swapping hands the hole's buffers to the freed slot
+        std::swap (slots[hole], slots[next]);
+        Slot& moved = slots[hole];
+
+        if (moved.prev >= 0)
+            slots[moved.prev].next = int (hole);
+        else
+            head = int (hole);
+
+        if (moved.next >= 0)
+            slots[moved.next].prev = int (hole);
+        else
+            tail = int (hole);
+
+        hole = next;
+    }
+}
@@ -0,0 +1,139 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __REPLYCACHE_H_5D8E3A61__
+#define __REPLYCACHE_H_5D8E3A61__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ Remembers the replies to recent commands so a client that retries after a
+ timeout gets the original reply back instead of the command running twice.
+
+ Requests are identified by the sending host and process, the id the client
+ gave the request, and a caller-supplied value that tells apart commands a
+ client might send under the same id, such as start and stop. A retry re-sends
+ the same id, so it maps to the same key; a new request gets a new id even
+ when it repeats an earlier command.
+
+ Entries live in a fixed-size open-addressing table with linear probing and
+ are threaded on an LRU list; once the table is full the least recently used
+ entry is evicted, so lookups stay O(1) and memory stays bounded however many
+ retries arrive. Entries older than the retry window no longer match, so a
+ client that restarts its ids can still send the same command again later.
+
+ Not thread-safe: the I/O thread owns it.
+*/
+class ReplyCache
+{
+public:
+
+    struct Key
+    {
+        uint64_t hash;
+        uint64_t check;
+    };
+
+    enum Result
+    {
+        /** Not seen within the retry window: run the command */
+        MISS,
+        /** Still running; its reply will go out when it finishes */
+        PENDING,
+        /** Already answered; send the cached reply */
+        HIT
+    };
+
+    /** Constructor */
+    ReplyCache (int capacity = 256, int64_t retryWindowNanos = 10000000000LL);
+
+    /** Key for a request */
+    static Key makeKey (const std::string& host, const std::string& process,
+                        uint64_t requestId, uint64_t discriminator);
+
+    /** Look a request up. On a hit, id and reply point at the cached reply until the next
+        call that modifies the cache. */
+    Result lookup (const Key& key, int64_t nowNanos, const std::string** id, const std::string** reply);
+
+    /** Record a request that is about to run, evicting the least recently used entry if full */
+    void insert (const Key& key, int64_t nowNanos);
+
+    /** Store the serialized reply of a request added with insert(); ignored if it was evicted since */
+    void complete (const Key& key, const std::string& id, const std::string& reply);
+
+    /** Number of cached requests */
+    int size() const { return count; }
+
+    uint64_t getHitCount() const { return hitCount; }
+    uint64_t getPendingHitCount() const { return pendingHitCount; }
+    uint64_t getMissCount() const { return missCount; }
+    uint64_t getEvictionCount() const { return evictionCount; }
+
+private:
+
+    struct Slot
+    {
+        Key key;
+        bool used;
+        bool pending;
+        int64_t insertedNanos;
+        /** LRU neighbours, as slot indices; -1 at the ends */
+        int prev;
+        int next;
+        std::string id;
+        std::string reply;
+    };
+
+    /** Slot holding the key, or -1 */
+    int find (const Key& key) const;
+
+    void unlink (int slot);
+    void pushFront (int slot);
+
+    /** Empty a slot, shifting later entries of its probe run back so lookups still find them */
+    void remove (int slot);
+
+    std::vector<Slot> slots;
+    uint32_t slotMask;
+    int capacity;
+    int count;
+    int64_t retryWindowNanos;
+
+    /** Most and least recently used slots, -1 when empty */
+    int head;
+    int tail;
+
+    // written by the I/O thread, read by the metrics request
+    std::atomic<uint64_t> hitCount;
+    std::atomic<uint64_t> pendingHitCount;
+    std::atomic<uint64_t> missCount;
+    std::atomic<uint64_t> evictionCount;
+
+    ReplyCache (const ReplyCache&) = delete;
+    ReplyCache& operator= (const ReplyCache&) = delete;
+};
+
+#endif  // __REPLYCACHE_H_5D8E3A61__
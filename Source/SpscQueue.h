@@ -0,0 +1,137 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SPSCQUEUE_H_C4E81B52__
+#define __SPSCQUEUE_H_C4E81B52__
+
+#include <atomic>
+#include <vector>
+
+/**
+ Bounded lock-free queue for exactly one producer thread and one consumer thread.
+
+ Capacity is rounded up to a power of two and all slots are allocated up front.
+ push() and pop() never block and never allocate; push() fails when the queue is
+ full. Large items can be filled and read in place with beginPush()/commitPush()
+ and front()/popFront() to avoid copying them.
+*/
+template <typename T>
+class SpscQueue
+{
+public:
+
+    /** Constructor */
+    SpscQueue (size_t capacity)
+        : head (0)
+        , tail (0)
+    {
+        size_t size = 2;
+
+        while (size < capacity)
+            size *= 2;
+
+        slots.resize (size);
+        mask = size - 1;
+    }
+
+    /** Producer: add an item; returns false if the queue is full */
+    bool push (const T& item)
+    {
+        const size_t t = tail.load (std::memory_order_relaxed);
+
+        if (t - head.load (std::memory_order_acquire) > mask)
+            return false;
+
+        slots[t & mask] = item;
+        tail.store (t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /** Consumer: remove the oldest item; returns false if the queue is empty */
+    bool pop (T& item)
+    {
+        const size_t h = head.load (std::memory_order_relaxed);
+
+        if (h == tail.load (std::memory_order_acquire))
+            return false;
+
+        item = slots[h & mask];
+        head.store (h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /** Producer: slot to fill in place, or nullptr if the queue is full. Call commitPush() when done. */
+    T* beginPush()
+    {
+        const size_t t = tail.load (std::memory_order_relaxed);
+
+        if (t - head.load (std::memory_order_acquire) > mask)
+            return nullptr;
+
+        return &slots[t & mask];
+    }
+
+    /** Producer: publish the slot returned by beginPush() */
+    void commitPush()
+    {
+        tail.store (tail.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Consumer: oldest item, read in place, or nullptr if the queue is empty. Call popFront() when done. */
+    T* front()
+    {
+        const size_t h = head.load (std::memory_order_relaxed);
+
+        if (h == tail.load (std::memory_order_acquire))
+            return nullptr;
+
+        return &slots[h & mask];
+    }
+
+    /** Consumer: release the item returned by front() */
+    void popFront()
+    {
+        head.store (head.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Approximate number of queued items; exact when called from either end */
+    size_t size() const
+    {
+        return tail.load (std::memory_order_acquire) - head.load (std::memory_order_acquire);
+    }
+
+    bool isEmpty() const { return size() == 0; }
+
+private:
+
+    std::vector<T> slots;
+    size_t mask;
+
+    // kept on separate cache lines so producer and consumer don't contend
+    alignas (64) std::atomic<size_t> head;
+    alignas (64) std::atomic<size_t> tail;
+};
+
+#endif  // __SPSCQUEUE_H_C4E81B52__
@@ -0,0 +1,159 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel (int numSlots, int64_t tickNanos_)
+    : slots         (size_t (numSlots > 0 ? numSlots : 1), -1)
+    , tickNanos     (tickNanos_ > 0 ? tickNanos_ : 1)
+    , currentTick   (0)
+    , numScheduled  (0)
+{
+}
+
+void TimerWheel::reset (int numTimers)
+{
+    std::fill (slots.begin(), slots.end(), -1);
+
+    Timer idle = { 0, -1, -1, -1 };
+    timers.assign (size_t (numTimers > 0 ? numTimers : 0), idle);
+    numScheduled = 0;
+}
+
+void TimerWheel::schedule (int timer, int64_t dueNanos)
+{
+    if (isScheduled (timer))
+        unlink (timer);
+
+    // never into a slot advance() has finished with, so an expiry in the past
+    // still fires
+    const int64_t tick = std::max (dueNanos / tickNanos, currentTick + 1);
+    const int slot = int (tick % int64_t (slots.size()));
+
+    Timer& t = timers[timer];
+    t.dueNanos = dueNanos;
+    t.slot = slot;
+    t.prev = -1;
+    t.next = slots[slot];
+
+    if (t.next >= 0)
+        timers[t.next].prev = timer;
+
+    slots[slot] = timer;
+    numScheduled++;
+}
+
+void TimerWheel::cancel (int timer)
+{
+    if (isScheduled (timer))
+        unlink (timer);
+}
+
+bool TimerWheel::isScheduled (int timer) const
+{
+    return timer >= 0 && timer < int (timers.size()) && timers[timer].slot >= 0;
+}
+
+int TimerWheel::advance (int64_t nowNanos, const Callback& callback)
+{
+    const int64_t targetTick = nowNanos / tickNanos;
+
+    if (targetTick <= currentTick)
+        return 0;
+
+    // after a long gap one pass over the wheel covers every slot
+    int64_t tick = std::max (currentTick + 1, targetTick - int64_t (slots.size()) + 1);
+    int fired = 0;
+
+    // timers later in the current tick are still waiting, so its slot is looked at again
+    // next time; anything rescheduled from the callback goes there or later
+    currentTick = targetTick - 1;
+
+    for (; tick <= targetTick; tick++)
+    {
+        int timer = slots[size_t (tick % int64_t (slots.size()))];
+
+        while (timer >= 0)
+        {
+            // the callback may reschedule this one, so step past it first
+            const int next = timers[timer].next;
+
+            if (timers[timer].dueNanos <= nowNanos)
+            {
+                unlink (timer);
+                fired++;
+                callback (timer);
+            }
+
+            timer = next;
+        }
+    }
+
+    return fired;
+}
+
+int TimerWheel::getTimeoutMs (int64_t nowNanos) const
+{
+    if (numScheduled == 0)
+        return -1;
+
+    // the first slot holding a timer due within its own turn of the wheel bounds the
+    // wait; timers a turn or more ahead only count if they come sooner
+    int64_t earliest = INT64_MAX;
+
+    for (size_t i = 1; i <= slots.size(); i++)
+    {
+        const int64_t tick = currentTick + int64_t (i);
+
+        for (int timer = slots[size_t (tick % int64_t (slots.size()))]; timer >= 0; timer = timers[timer].next)
+            earliest = std::min (earliest, timers[timer].dueNanos);
+
+        if (earliest < (tick + 1) * tickNanos)
+            break;
+    }
+
+    if (earliest <= nowNanos)
+        return 0;
+
+    return int (std::min (int64_t (INT32_MAX), (earliest - nowNanos + 999999) / 1000000));
+}
+
+void TimerWheel::unlink (int timer)
+{
+    Timer& t = timers[timer];
+
+    if (t.prev >= 0)
+        timers[t.prev].next = t.next;
+    else
+        slots[t.slot] = t.next;
+
+    if (t.next >= 0)
+        timers[t.next].prev = t.prev;
+
+    t.slot = -1;
+    t.prev = -1;
+    t.next = -1;
+    numScheduled--;
+}
@@ -0,0 +1,89 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TIMERWHEEL_H_2C6F9B83__
+#define __TIMERWHEEL_H_2C6F9B83__
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ Hashed timer wheel for the I/O thread's periodic work.
+
+ Timers are numbered 0 to numTimers - 1 and each has at most one expiry
+ pending. Scheduling, cancelling and firing a timer are O(1); advancing
+ touches one slot per elapsed tick, so the loop can run it every time it
+ wakes without regard to how many timers there are. Timers never fire
+ early; one scheduled into a tick that has already been processed waits for
+ the next tick.
+
+ Not thread-safe: the I/O thread owns it.
+*/
+class TimerWheel
+{
+public:
+
+    typedef std::function<void (int timer)> Callback;
+
+    /** Constructor */
+    TimerWheel (int numSlots = 256, int64_t tickNanos = 10000000);
+
+    /** Cancel everything and make room for numTimers timers */
+    void reset (int numTimers);
+
+    /** Fire the timer at the given host time, replacing any pending expiry */
+    void schedule (int timer, int64_t dueNanos);
+
+    void cancel (int timer);
+
+    bool isScheduled (int timer) const;
+
+    /** Fire every timer due by now, in tick order. The callback may reschedule any timer;
+        one rescheduled for now or earlier fires at most once per tick. Returns the number fired. */
+    int advance (int64_t nowNanos, const Callback& callback);
+
+    /** Milliseconds until the next timer is due (0 if one is overdue), or -1 if none is scheduled */
+    int getTimeoutMs (int64_t nowNanos) const;
+
+private:
+
+    struct Timer
+    {
+        int64_t dueNanos;
+        int slot;
+        int prev;
+        int next;
+    };
+
+    void unlink (int timer);
+
+    std::vector<Timer> timers;
+    std::vector<int> slots;
+    int64_t tickNanos;
+    /** Last tick advance() has finished with */
+    int64_t currentTick;
+    int numScheduled;
+};
+
+#endif  // __TIMERWHEEL_H_2C6F9B83__
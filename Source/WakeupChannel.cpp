@@ -0,0 +1,100 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "WakeupChannel.h"
+
+#include "resources/zmq.h"
+
+#include <iostream>
+
+WakeupChannel::WakeupChannel()
+    : receiver (nullptr)
+    , sender (nullptr)
+{
+}
+
+WakeupChannel::~WakeupChannel()
+{
+    close();
+}
+
+bool WakeupChannel::open (void* context, const std::string& name)
+{
+    close();
+
+    const std::string endpoint = "inproc://" + name;
+    int lingervalue = 0;
+    int sendhwm = 1; // a few pending wakeups are as good as many
+
+    receiver = zmq_socket (context, ZMQ_PAIR);
+    zmq_setsockopt (receiver, ZMQ_LINGER, &lingervalue, sizeof lingervalue);
+
+    // inproc needs the bind before the connect
+    if (zmq_bind (receiver, endpoint.c_str()) != 0)
+    {
+        std::cout << "Failed to open wakeup channel: " << zmq_strerror (zmq_errno()) << std::endl;
+        close();
+        return false;
+    }
+
+    sender = zmq_socket (context, ZMQ_PAIR);
+    zmq_setsockopt (sender, ZMQ_LINGER, &lingervalue, sizeof lingervalue);
+    zmq_setsockopt (sender, ZMQ_SNDHWM, &sendhwm, sizeof sendhwm);
+    zmq_connect (sender, endpoint.c_str());
+
+    return true;
+}
+
+void WakeupChannel::close()
+{
+    std::lock_guard<std::mutex> sl (senderLock);
+
+    if (sender != nullptr)
+    {
+        zmq_close (sender);
+        sender = nullptr;
+    }
+
+    if (receiver != nullptr)
+    {
+        zmq_close (receiver);
+        receiver = nullptr;
+    }
+}
+
+void WakeupChannel::wake()
+{
+    std::lock_guard<std::mutex> sl (senderLock);
+
+    // EAGAIN just means a wakeup is already pending
+    if (sender != nullptr)
+        zmq_send (sender, "", 0, ZMQ_DONTWAIT);
+}
+
+void WakeupChannel::drain()
+{
+    char dummy;
+
+    while (zmq_recv (receiver, &dummy, sizeof dummy, ZMQ_DONTWAIT) >= 0)
+        ;
+}
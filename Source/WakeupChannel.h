@@ -0,0 +1,73 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __WAKEUPCHANNEL_H_19D7B3F2__
+#define __WAKEUPCHANNEL_H_19D7B3F2__
+
+#include <mutex>
+#include <string>
+
+/**
+ inproc PAIR socket pair used to wake an I/O thread blocked in zmq_poll.
+
+ The receiving end goes in the I/O thread's poll set; any thread may call wake().
+ Wakeups that pile up before the I/O thread runs are drained together.
+*/
+class WakeupChannel
+{
+public:
+
+    /** Constructor */
+    WakeupChannel();
+
+    /** Destructor */
+    ~WakeupChannel();
+
+    /** Create and connect both ends on a unique inproc endpoint */
+    bool open (void* context, const std::string& name);
+
+    /** Close both ends */
+    void close();
+
+    /** Wake the I/O thread (any thread) */
+    void wake();
+
+    /** Discard pending wakeups (I/O thread) */
+    void drain();
+
+    /** The end to add to the I/O thread's poll set */
+    void* getSocket() const { return receiver; }
+
+private:
+
+    void* receiver;
+    void* sender;
+
+    // ZMQ sockets aren't thread-safe, and wake() can be called from anywhere
+    std::mutex senderLock;
+
+    WakeupChannel (const WakeupChannel&) = delete;
+    WakeupChannel& operator= (const WakeupChannel&) = delete;
+};
+
+#endif  // __WAKEUPCHANNEL_H_19D7B3F2__
@@ -0,0 +1,220 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ZmqContext.h"
+
+#include "resources/zmq.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+#if defined (__linux__) && ! defined (ZMQ_THREAD_AFFINITY_CPU_ADD)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace
+{
+    std::mutex contextLock;
+    void* context = nullptr;
+    int users = 0;
+    ZmqContextSettings configured;
+    ZmqContextSettings active;
+}
+
+ZmqContextSettings::ZmqContextSettings()
+    : ioThreads     (ZMQ_IO_THREADS_DFLT)
+    , maxSockets    (ZMQ_MAX_SOCKETS_DFLT)
+{
+}
+
+std::string ZmqContextSettings::cpusToString() const
+{
+    std::string text;
+
+    for (size_t i = 0; i < ioThreadCpus.size(); i++)
+        text += (i > 0 ? "," : "") + std::to_string (ioThreadCpus[i]);
+
+    return text;
+}
+
+void ZmqContextSettings::cpusFromString (const std::string& text)
+{
+    ioThreadCpus.clear();
+
+    size_t start = 0;
+
+    while (start < text.length())
+    {
+        size_t comma = text.find (',', start);
+
+        if (comma == std::string::npos)
+            comma = text.length();
+
+        const std::string item = text.substr (start, comma - start);
+        char* end = nullptr;
+        const long cpu = strtol (item.c_str(), &end, 10);
+
+        if (end != item.c_str() && cpu >= 0)
+            ioThreadCpus.push_back (int (cpu));
+
+        start = comma + 1;
+    }
+}
+
+void ZmqContext::retain()
+{
+    const std::lock_guard<std::mutex> sl (contextLock);
+
+    users++;
+}
+
+void ZmqContext::release()
+{
+    const std::lock_guard<std::mutex> sl (contextLock);
+
+    if (users > 0)
+        users--;
+
+    if (users == 0 && context != nullptr)
+    {
+        std::cout << "Destroying ZMQ context" << std::endl;
+
+        // blocks until every socket is closed, hence closing them all first
+        zmq_ctx_term (context);
+        context = nullptr;
+    }
+}
+
+void* ZmqContext::get()
+{
+    const std::lock_guard<std::mutex> sl (contextLock);
+
+    if (context == nullptr)
+    {
+        context = create (configured);
+        active = configured;
+    }
+
+    return context;
+}
+
+void ZmqContext::configure (const ZmqContextSettings& settings)
+{
+    const std::lock_guard<std::mutex> sl (contextLock);
+
+    configured = settings;
+}
+
+ZmqContextSettings ZmqContext::getSettings()
+{
+    const std::lock_guard<std::mutex> sl (contextLock);
+
+    return configured;
+}
+
+ZmqContextSettings ZmqContext::getActiveSettings()
+{
+    const std::lock_guard<std::mutex> sl (contextLock);
+
+    return context != nullptr ? active : configured;
+}
+
+int ZmqContext::getUserCount()
+{
+    const std::lock_guard<std::mutex> sl (contextLock);
+
+    return users;
+}
+
+void* ZmqContext::create (const ZmqContextSettings& settings)
+{
+    void* newContext = zmq_ctx_new();
+
+    if (newContext == nullptr)
+    {
+        std::cout << "Failed to create ZMQ context: " << zmq_strerror (zmq_errno()) << std::endl;
+        return nullptr;
+    }
+
+    // both only take effect before the first socket is created
+    if (zmq_ctx_set (newContext, ZMQ_IO_THREADS, settings.ioThreads) != 0)
+        std::cout << "Can't use " << settings.ioThreads << " ZMQ I/O threads: " << zmq_strerror (zmq_errno()) << std::endl;
+
+    if (zmq_ctx_set (newContext, ZMQ_MAX_SOCKETS, settings.maxSockets) != 0)
+        std::cout << "Can't allow " << settings.maxSockets << " ZMQ sockets: " << zmq_strerror (zmq_errno()) << std::endl;
+
+    std::cout << "Created ZMQ context with " << settings.ioThreads << " I/O threads";
+
+    if (! settings.ioThreadCpus.empty())
+        std::cout << " on cores " << settings.cpusToString();
+
+    std::cout << std::endl;
+
+    if (! settings.ioThreadCpus.empty())
+        pinIoThreads (newContext, settings.ioThreadCpus);
+
+    return newContext;
+}
+
+void ZmqContext::pinIoThreads (void* newContext, const std::vector<int>& cpus)
+{
+#if defined (ZMQ_THREAD_AFFINITY_CPU_ADD)
+    for (int cpu : cpus)
+        zmq_ctx_set (newContext, ZMQ_THREAD_AFFINITY_CPU_ADD, cpu);
+#elif defined (__linux__)
+    pthread_t self = pthread_self();
+    cpu_set_t original;
+    cpu_set_t pinned;
+
+    if (pthread_getaffinity_np (self, sizeof (original), &original) != 0)
+        return;
+
+    CPU_ZERO (&pinned);
+
+    for (int cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET (cpu, &pinned);
+    }
+
+    if (pthread_setaffinity_np (self, sizeof (pinned), &pinned) != 0)
+    {
+        std::cout << "Can't pin ZMQ I/O threads to the chosen cores" << std::endl;
+        return;
+    }
+
+    // the first socket starts the I/O threads, which inherit the mask
+    void* starter = zmq_socket (newContext, ZMQ_PAIR);
+
+    if (starter != nullptr)
+        zmq_close (starter);
+
+    pthread_setaffinity_np (self, sizeof (original), &original);
+#else
+    (void) newContext;
+    (void) cpus;
+    std::cout << "Pinning ZMQ I/O threads isn't supported on this platform" << std::endl;
+#endif
+}
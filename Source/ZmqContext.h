@@ -0,0 +1,100 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __ZMQCONTEXT_H_3B9C6E25__
+#define __ZMQCONTEXT_H_3B9C6E25__
+
+#include <string>
+#include <vector>
+
+/**
+ How the shared ZMQ context is created.
+*/
+struct ZmqContextSettings
+{
+    ZmqContextSettings();
+
+    /** ZMQ_IO_THREADS: threads moving TCP and IPC traffic for every socket in the process */
+    int ioThreads;
+
+    /** ZMQ_MAX_SOCKETS */
+    int maxSockets;
+
+    /** Cores to run the I/O threads on; empty to leave them to the scheduler */
+    std::vector<int> ioThreadCpus;
+
+    /** The cores as a comma-separated list, and back; unparseable entries are skipped */
+    std::string cpusToString() const;
+    void cpusFromString (const std::string& text);
+};
+
+/**
+ The ZMQ context shared by every plugin instance in the process.
+
+ Each instance calls retain() when it is created and release() when it is
+ destroyed, after closing all of its sockets; the last release() destroys
+ the context. The context itself is created on the first get(), so settings
+ loaded with the first instance's parameters still apply. Settings changed
+ while the context exists take effect once every instance has released it.
+
+ I/O thread pinning uses ZMQ_THREAD_AFFINITY_CPU_ADD where libzmq has it
+ (4.3 on). Older versions start their I/O threads with the first socket,
+ and on Linux new threads inherit their creator's affinity, so the calling
+ thread is pinned to the chosen cores for just long enough to create one.
+ Elsewhere pinning isn't available and the cores are ignored.
+
+ All functions are thread-safe.
+*/
+class ZmqContext
+{
+public:
+
+    /** Register a user */
+    static void retain();
+
+    /** Unregister a user; the last one destroys the context, so its sockets must already be closed */
+    static void release();
+
+    /** The context, created with the current settings if it doesn't exist yet */
+    static void* get();
+
+    static void configure (const ZmqContextSettings& settings);
+    static ZmqContextSettings getSettings();
+
+    /** Settings the current context was created with, or the configured ones if there is none */
+    static ZmqContextSettings getActiveSettings();
+
+    static int getUserCount();
+
+private:
+
+    /** Create the context; called with the lock held */
+    static void* create (const ZmqContextSettings& settings);
+
+    /** Start the I/O threads on the chosen cores; called with the lock held */
+    static void pinIoThreads (void* context, const std::vector<int>& cpus);
+
+    ZmqContext() = delete;
+};
+
+#endif  // __ZMQCONTEXT_H_3B9C6E25__
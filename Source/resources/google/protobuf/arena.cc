@@ -56,14 +56,24 @@ ArenaImpl::ThreadCache& ArenaImpl::thread_cache() {
   return *thread_cache_->Get();
 }
 #elif defined(PROTOBUF_USE_DLLS)
-ArenaImpl::ThreadCache& ArenaImpl::thread_cache() {
-  static GOOGLE_THREAD_LOCAL ThreadCache thread_cache_ = { -1, NULL };
+// Not a static member: thread local variables cannot have DLL interface.
+static GOOGLE_THREAD_LOCAL ArenaImpl::ThreadCache thread_cache_ = { -1, NULL };
+inline ArenaImpl::ThreadCache& ArenaImpl::thread_cache() {
   return thread_cache_;
 }
 #else
 GOOGLE_THREAD_LOCAL ArenaImpl::ThreadCache ArenaImpl::thread_cache_ = {-1, NULL};
 #endif
 
+inline void ArenaImpl::CacheBlock(Block* block) {
+  thread_cache().last_block_used_ = block;
+  thread_cache().last_lifecycle_id_seen = lifecycle_id_;
+  // TODO(haberman): evaluate whether we would gain efficiency by getting rid
+  // of hint_.  It's the only write we do to ArenaImpl in the allocation path,
+  // which will dirty the cache line.
+  google::protobuf::internal::Release_Store(&hint_, reinterpret_cast<google::protobuf::internal::AtomicWord>(block));
+}
+
 void ArenaImpl::Init() {
   lifecycle_id_ = lifecycle_id_generator_.GetNext();
   google::protobuf::internal::NoBarrier_Store(&hint_, 0);
@@ -91,13 +101,15 @@ ArenaImpl::~ArenaImpl() {
   // refer to memory in other blocks.
   CleanupList();
   FreeBlocks();
+  FreeRecycledBlocks();
 }
 
 uint64 ArenaImpl::Reset() {
   // Have to do this in a first pass, because some of the destructors might
   // refer to memory in other blocks.
   CleanupList();
-  uint64 space_allocated = FreeBlocks();
+  uint64 space_allocated =
+      options_.recycle_blocks ? RecycleBlocks() : FreeBlocks();
   Init();
 
   return space_allocated;
@@ -106,17 +118,24 @@ uint64 ArenaImpl::Reset() {
 ArenaImpl::Block* ArenaImpl::NewBlock(void* me, Block* my_last_block,
                                       size_t min_bytes) {
   size_t size;
-  if (my_last_block != NULL) {
+  if (my_last_block != NULL &&
+      !(options_.recycle_blocks && my_last_block == initial_block_)) {
     // Double the current block size, up to a limit.
     size = std::min(2 * my_last_block->size, options_.max_block_size);
   } else {
-    size = options_.start_block_size;
+    size = start_block_size_;
   }
   // Verify that min_bytes + kHeaderSize won't overflow.
   GOOGLE_CHECK_LE(min_bytes, std::numeric_limits<size_t>::max() - kHeaderSize);
   size = std::max(size, kHeaderSize + min_bytes);
 
-  Block* b = reinterpret_cast<Block*>(options_.block_alloc(size));
+  Block* b = options_.recycle_blocks ? TakeRecycledBlock(size) : NULL;
+  if (b != NULL) {
+    size = b->size;
+  } else {
+    b = reinterpret_cast<Block*>(options_.block_alloc(size));
+    google::protobuf::internal::NoBarrier_AtomicIncrement(&blocks_allocated_, 1);
+  }
   InitBlock(b, me, size);
   google::protobuf::internal::NoBarrier_AtomicIncrement(&space_allocated_, size);
   return b;
@@ -264,6 +283,34 @@ uint64 ArenaImpl::SpaceUsed() const {
   return space_used;
 }
 
+ArenaImpl::BlockStats ArenaImpl::GetBlockStats() const {
+  BlockStats stats;
+  stats.space_allocated = SpaceAllocated();
+  stats.space_used = 0;
+  stats.space_wasted = 0;
+
+  ThreadInfo* info =
+      reinterpret_cast<ThreadInfo*>(google::protobuf::internal::Acquire_Load(&threads_));
+  for ( ; info; info = info->next) {
+    stats.space_used -= sizeof(ThreadInfo);
+    for (Block* b = info->head; b; b = b->next) {
+      stats.space_used += (b->pos - kHeaderSize);
+      // Only the head block of a thread is still being allocated from.
+      if (b != info->head) {
+        stats.space_wasted += b->avail();
+      }
+    }
+  }
+
+  MutexLock lock(&recycled_mutex_);
+  stats.space_recycled = recycled_size_;
+  stats.blocks_allocated =
+      google::protobuf::internal::NoBarrier_Load(&blocks_allocated_);
+  stats.blocks_reused = blocks_reused_;
+  stats.start_block_size = start_block_size_;
+  return stats;
+}
+
 uint64 ArenaImpl::FreeBlocks() {
   uint64 space_allocated = 0;
   // By omitting an Acquire barrier we ensure that any user code that doesn't
@@ -297,6 +344,87 @@ uint64 ArenaImpl::FreeBlocks() {
   return space_allocated;
 }
 
+uint64 ArenaImpl::RecycleBlocks() {
+  uint64 space_allocated = 0;
+  // Whatever the cycle that just ended did not take, it did not need.
+  FreeRecycledBlocks();
+
+  ThreadInfo* info =
+      reinterpret_cast<ThreadInfo*>(google::protobuf::internal::NoBarrier_Load(&threads_));
+
+  size_t max_thread_space_used = 0;
+  while (info) {
+    // This is inside a block we are recycling, so we need to read it now.
+    ThreadInfo* next_info = info->next;
+    size_t thread_space_used = 0;
+    for (Block* b = info->head; b; ) {
+      Block* next_block = b->next;
+      space_allocated += (b->size);
+
+      if (b != initial_block_) {
+        thread_space_used += b->pos - kHeaderSize;
+        AddRecycledBlock(b);
+      } else {
+#ifdef ADDRESS_SANITIZER
+        ASAN_UNPOISON_MEMORY_REGION(reinterpret_cast<char*>(b), b->size);
+#endif  // ADDRESS_SANITIZER
+      }
+
+      b = next_block;
+    }
+    max_thread_space_used = std::max(max_thread_space_used, thread_space_used);
+    info = next_info;
+  }
+
+  // Size the next first block so that the busiest thread's allocations fit in
+  // it, within the configured block sizes. After a lighter cycle it shrinks by
+  // at most half, so one quiet cycle does not undo the sizing for the usual
+  // load.
+  if (max_thread_space_used > 0) {
+    size_t target = std::min(kHeaderSize + AlignUpTo8(max_thread_space_used),
+                             options_.max_block_size);
+    target = std::max(target, options_.start_block_size);
+    start_block_size_ = std::max(target, start_block_size_ / 2);
+  }
+
+  return space_allocated;
+}
+
+void ArenaImpl::FreeRecycledBlocks() {
+  while (recycled_) {
+    Block* b = recycled_;
+    recycled_ = b->next;
+#ifdef ADDRESS_SANITIZER
+    ASAN_UNPOISON_MEMORY_REGION(reinterpret_cast<char*>(b), b->size);
+#endif  // ADDRESS_SANITIZER
+    options_.block_dealloc(b, b->size);
+  }
+  recycled_size_ = 0;
+}
+
+void ArenaImpl::AddRecycledBlock(Block* b) {
+  InitBlock(b, NULL, b->size);
+  Block** link = &recycled_;
+  while (*link != NULL && (*link)->size > b->size) {
+    link = &(*link)->next;
+  }
+  b->next = *link;
+  *link = b;
+  recycled_size_ += b->size;
+}
+
+ArenaImpl::Block* ArenaImpl::TakeRecycledBlock(size_t size) {
+  MutexLock lock(&recycled_mutex_);
+  Block* b = recycled_;
+  if (b == NULL || b->size < size) {
+    return NULL;
+  }
+  recycled_ = b->next;
+  recycled_size_ -= b->size;
+  blocks_reused_++;
+  return b;
+}
+
 void ArenaImpl::CleanupList() {
   // By omitting an Acquire barrier we ensure that any user code that doesn't
   // properly synchronize Reset() or the destructor will throw a TSAN warning.
@@ -117,6 +117,16 @@ struct ArenaOptions {
   // from the arena. By default, it contains a ptr to a wrapper function that
   // calls free.
   void (*block_dealloc)(void*, size_t);
+
+  // If true, Reset() keeps the arena's blocks instead of passing them to
+  // block_dealloc, and the next cycle takes blocks from those before calling
+  // block_alloc. Kept blocks that a cycle did not take are freed by the
+  // following Reset(). The first block of each thread is also sized to the
+  // most space one thread used in the last cycle, up to max_block_size (and
+  // shrinking by at most half per cycle), so an arena that is reset after
+  // every batch of work settles on the same blocks and stops allocating.
+  bool recycle_blocks;
+
   // Hooks for adding external functionality such as user-specific metrics
   // collection, specific debugging abilities, etc.
   // Init hook may return a pointer to a cookie to be stored in the arena.
@@ -145,6 +155,7 @@ struct ArenaOptions {
         initial_block_size(0),
         block_alloc(&::operator new),
         block_dealloc(&internal::arena_free),
+        recycle_blocks(false),
         on_arena_init(NULL),
         on_arena_reset(NULL),
         on_arena_destruction(NULL),
@@ -526,11 +537,20 @@ class LIBPROTOBUF_EXPORT Arena {
     return std::make_pair(SpaceAllocated(), SpaceUsed());
   }
 
+  // Returns statistics about the arena's blocks: the space allocated, used and
+  // left unused at the end of full blocks since the last Reset(), the space
+  // kept by ArenaOptions::recycle_blocks, and how many blocks were obtained
+  // from block_alloc or reused over the arena's lifetime. Like SpaceUsed(), it
+  // may miss allocations made concurrently with the call.
+  typedef internal::ArenaImpl::BlockStats BlockStats;
+  BlockStats GetBlockStats() const { return impl_.GetBlockStats(); }
+
   // Frees all storage allocated by this arena after calling destructors
   // registered with OwnDestructor() and freeing objects registered with Own().
   // Any objects allocated on this arena are unusable after this call. It also
   // returns the total space used by the arena which is the sums of the sizes
-  // of the allocated blocks. This method is not thread-safe.
+  // of the allocated blocks. This method is not thread-safe. With
+  // ArenaOptions::recycle_blocks the blocks are kept for reuse instead.
   GOOGLE_PROTOBUF_ATTRIBUTE_NOINLINE uint64 Reset() {
     // Call the reset hook
     if (on_arena_reset_ != NULL) {
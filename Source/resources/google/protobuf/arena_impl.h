@@ -69,6 +69,7 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
     size_t initial_block_size;
     void* (*block_alloc)(size_t);
     void (*block_dealloc)(void*, size_t);
+    bool recycle_blocks;
 
     template <typename O>
     explicit Options(const O& options)
@@ -77,11 +78,29 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
         initial_block(options.initial_block),
         initial_block_size(options.initial_block_size),
         block_alloc(options.block_alloc),
-        block_dealloc(options.block_dealloc) {}
+        block_dealloc(options.block_dealloc),
+        recycle_blocks(options.recycle_blocks) {}
+  };
+
+  // Statistics about the blocks of an arena, see Arena::GetBlockStats().
+  struct BlockStats {
+    uint64 space_allocated;   // Sum of the sizes of the blocks in use.
+    uint64 space_used;        // Bytes allocated from them, see SpaceUsed().
+    uint64 space_wasted;      // Unused tails of blocks that filled up.
+    uint64 space_recycled;    // Sum of the sizes of blocks kept for reuse.
+    uint64 blocks_allocated;  // Blocks obtained from block_alloc, ever.
+    uint64 blocks_reused;     // Blocks taken from the recycled ones, ever.
+    size_t start_block_size;  // Size of the first block of each thread.
   };
 
   template <typename O>
-  explicit ArenaImpl(const O& options) : options_(options) {
+  explicit ArenaImpl(const O& options)
+      : options_(options),
+        recycled_(NULL),
+        recycled_size_(0),
+        blocks_reused_(0),
+        start_block_size_(options_.start_block_size) {
+    google::protobuf::internal::NoBarrier_Store(&blocks_allocated_, 0);
     if (options_.initial_block != NULL && options_.initial_block_size > 0) {
       GOOGLE_CHECK_GE(options_.initial_block_size, sizeof(Block))
           << ": Initial block size too small for header.";
@@ -103,6 +122,7 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
 
   uint64 SpaceAllocated() const;
   uint64 SpaceUsed() const;
+  BlockStats GetBlockStats() const;
 
   void* AllocateAligned(size_t n);
 
@@ -155,6 +175,9 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
     // data follows
   };
 
+ public:
+  // Only public so that arena.cc can name it when the thread-local cache is
+  // a file-local variable (see thread_cache() below); not part of the API.
   struct ThreadCache {
 #if defined(GOOGLE_PROTOBUF_NO_THREADLOCAL)
     // If we are using the ThreadLocalStorage class to store the ThreadCache,
@@ -168,6 +191,8 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
     int64 last_lifecycle_id_seen;
     Block* last_block_used_;
   };
+
+ private:
   static google::protobuf::internal::SequenceNumber lifecycle_id_generator_;
 #if defined(GOOGLE_PROTOBUF_NO_THREADLOCAL)
   // Android ndk does not support GOOGLE_THREAD_LOCAL keyword so we use a custom thread
@@ -175,9 +200,11 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
   // iOS also does not support the GOOGLE_THREAD_LOCAL keyword.
   static ThreadCache& thread_cache();
 #elif defined(PROTOBUF_USE_DLLS)
-  // Thread local variables cannot be exposed through DLL interface but we can
-  // wrap them in static functions.
-  static ThreadCache& thread_cache();
+  // Thread local variables cannot be exposed through DLL interface, so the
+  // cache lives in arena.cc, the only caller, which defines this accessor
+  // inline next to it. An out-of-line accessor would cost a call on every
+  // allocation.
+  static inline ThreadCache& thread_cache();
 #else
   static GOOGLE_THREAD_LOCAL ThreadCache thread_cache_;
   static ThreadCache& thread_cache() { return thread_cache_; }
@@ -188,20 +215,21 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
   // Free all blocks and return the total space used which is the sums of sizes
   // of the all the allocated blocks.
   uint64 FreeBlocks();
+  // Like FreeBlocks(), but keeps the blocks for the next cycle and frees the
+  // kept ones this cycle did not reuse instead.
+  uint64 RecycleBlocks();
+  void FreeRecycledBlocks();
+  void AddRecycledBlock(Block* b);
+  // Returns a kept block of at least |size| bytes, or NULL.
+  Block* TakeRecycledBlock(size_t size);
 
   void AddCleanupInBlock(Block* b, void* elem, void (*func)(void*));
   CleanupChunk* ExpandCleanupList(CleanupChunk* cleanup, Block* b);
   // Delete or Destruct all objects owned by the arena.
   void CleanupList();
 
-  inline void CacheBlock(Block* block) {
-    thread_cache().last_block_used_ = block;
-    thread_cache().last_lifecycle_id_seen = lifecycle_id_;
-    // TODO(haberman): evaluate whether we would gain efficiency by getting rid
-    // of hint_.  It's the only write we do to ArenaImpl in the allocation path,
-    // which will dirty the cache line.
-    google::protobuf::internal::Release_Store(&hint_, reinterpret_cast<google::protobuf::internal::AtomicWord>(block));
-  }
+  // Defined in arena.cc, where thread_cache() is available in every build.
+  inline void CacheBlock(Block* block);
 
   google::protobuf::internal::AtomicWord threads_;          // Pointer to a linked list of ThreadInfo.
   google::protobuf::internal::AtomicWord hint_;             // Fast thread-local block access
@@ -224,6 +252,19 @@ class LIBPROTOBUF_EXPORT ArenaImpl {
 
   Options options_;
 
+  // With options_.recycle_blocks, blocks kept by Reset(), largest first and
+  // linked through Block::next. Guarded by recycled_mutex_, as threads may
+  // take from them concurrently.
+  mutable Mutex recycled_mutex_;
+  Block* recycled_;
+  uint64 recycled_size_;
+  uint64 blocks_reused_;
+  google::protobuf::internal::AtomicWord blocks_allocated_;
+
+  // options_.start_block_size, adjusted with options_.recycle_blocks toward the
+  // most space one thread used in the last cycle, up to options_.max_block_size.
+  size_t start_block_size_;
+
   GOOGLE_DISALLOW_EVIL_CONSTRUCTORS(ArenaImpl);
 
  public:
@@ -1308,6 +1308,123 @@ TEST(ArenaTest, SpaceAllocated_and_Used) {
   EXPECT_EQ(256 + 512, arena_3.Reset());
 }
 
+TEST(ArenaTest, GetBlockStats) {
+  ArenaOptions options;
+  options.start_block_size = 256;
+  options.max_block_size = 8192;
+  Arena arena(options);
+  ::google::protobuf::Arena::CreateArray<char>(&arena, 150);
+  ::google::protobuf::Arena::CreateArray<char>(&arena, 90);
+  Arena::BlockStats stats = arena.GetBlockStats();
+  EXPECT_EQ(256 + 512, stats.space_allocated);
+  EXPECT_EQ(arena.SpaceUsed(), stats.space_used);
+  // The tail of the first block was too small for the second array.
+  EXPECT_GT(stats.space_wasted, 0);
+  EXPECT_LT(stats.space_wasted, Align8(90));
+  EXPECT_EQ(0, stats.space_recycled);
+  EXPECT_EQ(2, stats.blocks_allocated);
+  EXPECT_EQ(0, stats.blocks_reused);
+  EXPECT_EQ(256, stats.start_block_size);
+}
+
+int blocks_outstanding = 0;
+void* CountingBlockAlloc(size_t size) {
+  ++blocks_outstanding;
+  return ::operator new(size);
+}
+void CountingBlockDealloc(void* block, size_t size) {
+  --blocks_outstanding;
+  ::google::protobuf::internal::arena_free(block, size);
+}
+
+TEST(ArenaTest, RecycleBlocks) {
+  ArenaOptions options;
+  options.start_block_size = 256;
+  options.max_block_size = 16384;
+  options.block_alloc = &CountingBlockAlloc;
+  options.block_dealloc = &CountingBlockDealloc;
+  options.recycle_blocks = true;
+  {
+    Arena arena(options);
+    uint64 blocks_allocated = 0;
+    for (int cycle = 0; cycle < 5; cycle++) {
+      for (int i = 0; i < 100; i++) {
+        ::google::protobuf::Arena::CreateArray<char>(&arena, 100);
+      }
+      EXPECT_EQ(100 * Align8(100), arena.SpaceUsed());
+      Arena::BlockStats stats = arena.GetBlockStats();
+      if (cycle == 0) {
+        EXPECT_GT(stats.blocks_allocated, 1);
+      } else if (cycle == 1) {
+        // The first block now holds everything the first cycle used.
+        EXPECT_EQ(1, stats.blocks_allocated - blocks_allocated);
+        EXPECT_GE(stats.start_block_size, 100 * Align8(100));
+      } else {
+        // Steady state: the block from the previous cycle is reused.
+        EXPECT_EQ(blocks_allocated, stats.blocks_allocated);
+        EXPECT_EQ(1, blocks_outstanding);
+      }
+      blocks_allocated = stats.blocks_allocated;
+      arena.Reset();
+      EXPECT_EQ(0, arena.SpaceUsed());
+      EXPECT_LT(0, arena.GetBlockStats().space_recycled);
+    }
+    EXPECT_LT(1, arena.GetBlockStats().blocks_reused);
+
+    // Objects with destructors are still destroyed on Reset().
+    Arena::Create<std::string>(&arena, "recycled");
+    arena.Reset();
+  }
+  EXPECT_EQ(0, blocks_outstanding);
+}
+
+TEST(ArenaTest, RecycleBlocksStartSizeFollowsUsage) {
+  ArenaOptions options;
+  options.start_block_size = 256;
+  options.max_block_size = 4096;
+  options.recycle_blocks = true;
+  Arena arena(options);
+
+  // A cycle bigger than max_block_size doesn't raise the start size past it.
+  for (int i = 0; i < 100; i++) {
+    ::google::protobuf::Arena::CreateArray<char>(&arena, 100);
+  }
+  arena.Reset();
+  EXPECT_EQ(4096, arena.GetBlockStats().start_block_size);
+
+  // Light cycles bring it back down, halving at most each time.
+  size_t expected = 4096;
+  for (int cycle = 0; cycle < 5; cycle++) {
+    ::google::protobuf::Arena::CreateArray<char>(&arena, 100);
+    arena.Reset();
+    expected = std::max<size_t>(expected / 2, 256);
+    EXPECT_EQ(expected, arena.GetBlockStats().start_block_size);
+  }
+}
+
+TEST(ArenaTest, RecycleBlocksWithInitialBlock) {
+  std::vector<char> arena_block(1024);
+  ArenaOptions options;
+  options.initial_block = &arena_block[0];
+  options.initial_block_size = arena_block.size();
+  options.block_alloc = &CountingBlockAlloc;
+  options.block_dealloc = &CountingBlockDealloc;
+  options.recycle_blocks = true;
+  {
+    Arena arena(options);
+    for (int cycle = 0; cycle < 3; cycle++) {
+      ::google::protobuf::Arena::CreateArray<char>(&arena, 64);
+      char* past_initial = ::google::protobuf::Arena::CreateArray<char>(&arena, 4096);
+      EXPECT_TRUE(past_initial < &arena_block[0] ||
+                  past_initial >= &arena_block[0] + arena_block.size());
+      EXPECT_EQ(1, blocks_outstanding);
+      EXPECT_EQ(1, arena.GetBlockStats().blocks_allocated);
+      arena.Reset();
+    }
+  }
+  EXPECT_EQ(0, blocks_outstanding);
+}
+
 TEST(ArenaTest, Alignment) {
   ::google::protobuf::Arena arena;
   for (int i = 0; i < 200; i++) {
@@ -236,6 +236,11 @@ RepeatedEnumFieldGenerator::RepeatedEnumFieldGenerator(
     const FieldDescriptor* descriptor, const Options& options)
     : FieldGenerator(options), descriptor_(descriptor) {
   SetEnumVariables(descriptor, &variables_, options);
+  if (InlineRepeatedSize(descriptor) > 0) {
+    variables_["member_type"] = RepeatedFieldMemberType(descriptor, "int");
+  } else {
+    variables_["member_type"] = "::google::protobuf::RepeatedField<int>";
+  }
 }
 
 RepeatedEnumFieldGenerator::~RepeatedEnumFieldGenerator() {}
@@ -243,7 +248,7 @@ RepeatedEnumFieldGenerator::~RepeatedEnumFieldGenerator() {}
 void RepeatedEnumFieldGenerator::
 GeneratePrivateMembers(io::Printer* printer) const {
   printer->Print(variables_,
-    "::google::protobuf::RepeatedField<int> $name$_;\n");
+    "$member_type$ $name$_;\n");
   if (descriptor_->is_packed() &&
       HasGeneratedMethods(descriptor_->file(), options_)) {
     printer->Print(variables_,
@@ -433,7 +438,7 @@ GenerateMergeFromCodedStreamWithPacking(io::Printer* printer) const {
 void RepeatedEnumFieldGenerator::
 GenerateSerializeWithCachedSizes(io::Printer* printer) const {
   if (descriptor_->is_packed()) {
-    // Write the tag and the size.
+    // Write the tag and the size, then the whole array at once.
     printer->Print(variables_,
       "if (this->$name$_size() > 0) {\n"
       "  ::google::protobuf::internal::WireFormatLite::WriteTag(\n"
@@ -442,20 +447,16 @@ GenerateSerializeWithCachedSizes(io::Printer* printer) const {
       "    output);\n"
       "  output->WriteVarint32(\n"
       "      static_cast< ::google::protobuf::uint32>(_$name$_cached_byte_size_));\n"
+      "  ::google::protobuf::internal::WireFormatLite::WriteEnumArray(\n"
+      "    this->$name$().data(), this->$name$_size(), output);\n"
       "}\n");
-  }
-  printer->Print(variables_,
-      "for (int i = 0, n = this->$name$_size(); i < n; i++) {\n");
-  if (descriptor_->is_packed()) {
-    printer->Print(variables_,
-      "  ::google::protobuf::internal::WireFormatLite::WriteEnumNoTag(\n"
-      "    this->$name$(i), output);\n");
   } else {
     printer->Print(variables_,
+      "for (int i = 0, n = this->$name$_size(); i < n; i++) {\n"
       "  ::google::protobuf::internal::WireFormatLite::WriteEnum(\n"
-      "    $number$, this->$name$(i), output);\n");
+      "    $number$, this->$name$(i), output);\n"
+      "}\n");
   }
-  printer->Print("}\n");
 }
 
 void RepeatedEnumFieldGenerator::
@@ -485,14 +486,9 @@ void RepeatedEnumFieldGenerator::
 GenerateByteSize(io::Printer* printer) const {
   printer->Print(variables_,
     "{\n"
-    "  size_t data_size = 0;\n"
-    "  unsigned int count = static_cast<unsigned int>(this->$name$_size());");
+    "  size_t data_size = ::google::protobuf::internal::WireFormatLite::\n"
+    "    EnumSize(this->$name$_);\n");
   printer->Indent();
-  printer->Print(variables_,
-      "for (unsigned int i = 0; i < count; i++) {\n"
-      "  data_size += ::google::protobuf::internal::WireFormatLite::EnumSize(\n"
-      "    this->$name$(static_cast<int>(i)));\n"
-      "}\n");
 
   if (descriptor_->is_packed()) {
     printer->Print(variables_,
@@ -508,6 +504,7 @@ GenerateByteSize(io::Printer* printer) const {
       "total_size += data_size;\n");
   } else {
     printer->Print(variables_,
+      "unsigned int count = static_cast<unsigned int>(this->$name$_size());\n"
       "total_size += ($tag_size$UL * count) + data_size;\n");
   }
   printer->Outdent();
@@ -33,6 +33,7 @@
 //  Sanjay Ghemawat, Jeff Dean, and others.
 
 #include <google/protobuf/stubs/hash.h>
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <queue>
@@ -41,6 +42,7 @@
 #include <google/protobuf/stubs/logging.h>
 #include <google/protobuf/stubs/common.h>
 #include <google/protobuf/compiler/cpp/cpp_helpers.h>
+#include <google/protobuf/cpp_field_options.pb.h>
 #include <google/protobuf/io/printer.h>
 #include <google/protobuf/stubs/strutil.h>
 #include <google/protobuf/stubs/substitute.h>
@@ -278,6 +280,25 @@ int EstimateAlignmentSize(const FieldDescriptor* field) {
   return -1;  // Make compiler happy.
 }
 
+int InlineRepeatedSize(const FieldDescriptor* field) {
+  if (!field->is_repeated() ||
+      field->cpp_type() == FieldDescriptor::CPPTYPE_STRING ||
+      field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+    return 0;
+  }
+  return std::max(field->options().GetExtension(cpp_inline_size), 0);
+}
+
+string RepeatedFieldMemberType(const FieldDescriptor* field,
+                               const string& element_type) {
+  int inline_size = InlineRepeatedSize(field);
+  if (inline_size == 0) {
+    return "::google::protobuf::RepeatedField< " + element_type + " >";
+  }
+  return "::google::protobuf::InlinedRepeatedField< " + element_type + ", " +
+         SimpleItoa(inline_size) + " >";
+}
+
 string FieldConstantName(const FieldDescriptor *field) {
   string field_name = UnderscoresToCamelCase(field->name(), true);
   string result = "k" + field_name + "FieldNumber";
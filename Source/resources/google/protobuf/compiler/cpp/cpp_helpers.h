@@ -130,6 +130,16 @@ string EnumValueName(const EnumValueDescriptor* enum_value);
 // 64-bit pointers.
 int EstimateAlignmentSize(const FieldDescriptor* field);
 
+// Returns the number of elements a repeated scalar field keeps inside the
+// message, as set by its (google.protobuf.cpp_inline_size) option, or 0.
+int InlineRepeatedSize(const FieldDescriptor* field);
+
+// Get the type of the member holding a repeated scalar field whose elements
+// have C++ type |element_type|: a RepeatedField, or an InlinedRepeatedField
+// if InlineRepeatedSize() is not 0.
+string RepeatedFieldMemberType(const FieldDescriptor* field,
+                               const string& element_type);
+
 // Get the unqualified name that should be used for a field's field
 // number constant.
 string FieldConstantName(const FieldDescriptor *field);
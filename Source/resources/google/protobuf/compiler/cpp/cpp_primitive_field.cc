@@ -261,6 +261,8 @@ RepeatedPrimitiveFieldGenerator::RepeatedPrimitiveFieldGenerator(
     const FieldDescriptor* descriptor, const Options& options)
     : FieldGenerator(options), descriptor_(descriptor) {
   SetPrimitiveVariables(descriptor, &variables_, options);
+  variables_["member_type"] =
+      RepeatedFieldMemberType(descriptor, variables_["type"]);
 
   if (descriptor->is_packed()) {
     variables_["packed_reader"] = "ReadPackedPrimitive";
@@ -276,7 +278,7 @@ RepeatedPrimitiveFieldGenerator::~RepeatedPrimitiveFieldGenerator() {}
 void RepeatedPrimitiveFieldGenerator::
 GeneratePrivateMembers(io::Printer* printer) const {
   printer->Print(variables_,
-    "::google::protobuf::RepeatedField< $type$ > $name$_;\n");
+    "$member_type$ $name$_;\n");
   if (descriptor_->is_packed() &&
       HasGeneratedMethods(descriptor_->file(), options_)) {
     printer->Print(variables_,
@@ -388,16 +390,15 @@ GenerateSerializeWithCachedSizes(io::Printer* printer) const {
       "  output->WriteVarint32(static_cast< ::google::protobuf::uint32>(\n"
       "      _$name$_cached_byte_size_));\n");
 
-    if (FixedSize(descriptor_->type()) > 0) {
-      // TODO(ckennelly): Use RepeatedField<T>::unsafe_data() via
-      // WireFormatLite to access the contents of this->$name$_ to save a branch
-      // here.
-      printer->Print(variables_,
-        "  ::google::protobuf::internal::WireFormatLite::Write$declared_type$Array(\n"
-        "    this->$name$().data(), this->$name$_size(), output);\n");
-      array_written = true;  // Wrote array all at once
-    }
-    printer->Print(variables_, "}\n");
+    // Every packed type, fixed size or varint, has an array writer.
+    // TODO(ckennelly): Use RepeatedField<T>::unsafe_data() via
+    // WireFormatLite to access the contents of this->$name$_ to save a branch
+    // here.
+    printer->Print(variables_,
+      "  ::google::protobuf::internal::WireFormatLite::Write$declared_type$Array(\n"
+      "    this->$name$().data(), this->$name$_size(), output);\n"
+      "}\n");
+    array_written = true;  // Wrote array all at once
   }
   if (!array_written) {
     printer->Print(variables_,
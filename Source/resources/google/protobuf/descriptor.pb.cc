@@ -12871,10 +12871,8 @@ void SourceCodeInfo_Location::SerializeWithCachedSizes(
     ::google::protobuf::internal::WireFormatLite::WriteTag(1, ::google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED, output);
     output->WriteVarint32(static_cast< ::google::protobuf::uint32>(
         _path_cached_byte_size_));
-  }
-  for (int i = 0, n = this->path_size(); i < n; i++) {
-    ::google::protobuf::internal::WireFormatLite::WriteInt32NoTag(
-      this->path(i), output);
+    ::google::protobuf::internal::WireFormatLite::WriteInt32Array(
+      this->path().data(), this->path_size(), output);
   }
 
   // repeated int32 span = 2 [packed = true];
@@ -12882,10 +12880,8 @@ void SourceCodeInfo_Location::SerializeWithCachedSizes(
     ::google::protobuf::internal::WireFormatLite::WriteTag(2, ::google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED, output);
     output->WriteVarint32(static_cast< ::google::protobuf::uint32>(
         _span_cached_byte_size_));
-  }
-  for (int i = 0, n = this->span_size(); i < n; i++) {
-    ::google::protobuf::internal::WireFormatLite::WriteInt32NoTag(
-      this->span(i), output);
+    ::google::protobuf::internal::WireFormatLite::WriteInt32Array(
+      this->span().data(), this->span_size(), output);
   }
 
   cached_has_bits = _has_bits_[0];
@@ -13648,10 +13644,8 @@ void GeneratedCodeInfo_Annotation::SerializeWithCachedSizes(
     ::google::protobuf::internal::WireFormatLite::WriteTag(1, ::google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED, output);
     output->WriteVarint32(static_cast< ::google::protobuf::uint32>(
         _path_cached_byte_size_));
-  }
-  for (int i = 0, n = this->path_size(); i < n; i++) {
-    ::google::protobuf::internal::WireFormatLite::WriteInt32NoTag(
-      this->path(i), output);
+    ::google::protobuf::internal::WireFormatLite::WriteInt32Array(
+      this->path().data(), this->path_size(), output);
   }
 
   cached_has_bits = _has_bits_[0];
@@ -0,0 +1,642 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Decodes, encodes and sizes runs of varints many at a time, for packed
+// repeated fields.
+//
+// Values below 128 take one byte on the wire, and packed arrays of counts,
+// channel numbers, enums and timestamp deltas are mostly made of them.  The
+// SSE4.1 and AVX2 decoders look at 16 or 32 bytes at once and widen a block
+// with no continuation bits straight into the output; the portable decoder
+// does the same for 8-byte words.  Other varints are decoded from an 8-byte
+// load without testing their bytes one at a time.  In the other direction,
+// the SSE4.1 encoder narrows 16 values below 128 into 16 bytes with one
+// store, and the SSE4.1 size calculator sizes four 32-bit values at a time.
+// The best kernel the CPU supports is chosen the first time one is used.
+
+#ifndef GOOGLE_PROTOBUF_IO_BULK_VARINT_H__
+#define GOOGLE_PROTOBUF_IO_BULK_VARINT_H__
+
+#include <string.h>
+
+#include <google/protobuf/stubs/common.h>
+#include <google/protobuf/io/coded_stream.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GOOGLE_PROTOBUF_BULK_VARINT_X86 1
+#define GOOGLE_PROTOBUF_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define GOOGLE_PROTOBUF_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define GOOGLE_PROTOBUF_BULK_VARINT_X86 1
+#define GOOGLE_PROTOBUF_TARGET_SSE41
+#define GOOGLE_PROTOBUF_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace google {
+namespace protobuf {
+namespace io {
+namespace internal {
+
+enum BulkVarintKernel {
+  BULK_VARINT_SCALAR,
+  BULK_VARINT_SSE41,
+  BULK_VARINT_AVX2
+};
+
+// Returns the fastest kernel this CPU supports.
+inline BulkVarintKernel BestBulkVarintKernel();
+
+// Returns BestBulkVarintKernel(), working it out only once.
+inline BulkVarintKernel DefaultBulkVarintKernel() {
+  static const BulkVarintKernel kernel = BestBulkVarintKernel();
+  return kernel;
+}
+
+// Returns the name of a kernel, for benchmarks and diagnostics.
+inline const char* BulkVarintKernelName(BulkVarintKernel kernel);
+
+// Decodes up to max_values varints from [ptr, end) into out, stopping early
+// at a varint that does not end before `end`.  *consumed is set to the number
+// of bytes taken by the decoded varints.  Returns the number of values
+// decoded, or -1 if a varint is longer than ten bytes.
+//
+// uint32 output keeps the low 32 bits of each value, uint64 output keeps all
+// of them, as CodedInputStream::ReadVarint32() and ReadVarint64() do.  The
+// kernel must be one the CPU supports (at most BestBulkVarintKernel()).
+template <typename T>
+int DecodeVarintRun(BulkVarintKernel kernel, const uint8* ptr,
+                    const uint8* end, T* out, int max_values, int* consumed);
+
+// Like above, using DefaultBulkVarintKernel().
+template <typename T>
+inline int DecodeVarintRun(const uint8* ptr, const uint8* end, T* out,
+                           int max_values, int* consumed) {
+  return DecodeVarintRun(DefaultBulkVarintKernel(), ptr, end, out, max_values,
+                         consumed);
+}
+
+// How the elements of a packed field become varints on the wire.
+enum VarintEncoding {
+  VARINT_UNSIGNED,       // uint32, uint64: the value itself
+  VARINT_SIGN_EXTENDED,  // int32, int64, enums: negatives take ten bytes
+  VARINT_ZIGZAG          // sint32, sint64
+};
+
+// Returns the number of bytes the n values at data take as varints.  T is
+// int32, uint32, int64 or uint64.
+template <VarintEncoding E, typename T>
+size_t VarintRunSize(BulkVarintKernel kernel, const T* data, int n);
+
+// Writes the n values at data as varints to target, which must have room for
+// VarintRunSize() bytes, and returns a pointer past the last byte written.
+template <VarintEncoding E, typename T>
+uint8* EncodeVarintRun(BulkVarintKernel kernel, const T* data, int n,
+                       uint8* target);
+
+// Like above, using DefaultBulkVarintKernel().
+template <VarintEncoding E, typename T>
+inline size_t VarintRunSize(const T* data, int n) {
+  return VarintRunSize<E>(DefaultBulkVarintKernel(), data, n);
+}
+template <VarintEncoding E, typename T>
+inline uint8* EncodeVarintRun(const T* data, int n, uint8* target) {
+  return EncodeVarintRun<E>(DefaultBulkVarintKernel(), data, n, target);
+}
+
+// ===================================================================
+// implementation details follow; clients should ignore
+
+inline const char* BulkVarintKernelName(BulkVarintKernel kernel) {
+  switch (kernel) {
+    case BULK_VARINT_SSE41: return "sse4.1";
+    case BULK_VARINT_AVX2:  return "avx2";
+    default:                return "scalar";
+  }
+}
+
+inline BulkVarintKernel BestBulkVarintKernel() {
+#if defined(GOOGLE_PROTOBUF_BULK_VARINT_X86) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return BULK_VARINT_AVX2;
+  if (__builtin_cpu_supports("sse4.1")) return BULK_VARINT_SSE41;
+#elif defined(GOOGLE_PROTOBUF_BULK_VARINT_X86)
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+  __cpuid(info, 1);
+  const bool sse41 = (info[2] & (1 << 19)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (max_leaf >= 7 && osxsave && (_xgetbv(0) & 6) == 6) {
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 5)) != 0) return BULK_VARINT_AVX2;
+  }
+  if (sse41) return BULK_VARINT_SSE41;
+#endif
+  return BULK_VARINT_SCALAR;
+}
+
+inline int CountTrailingZeros32(uint32 n) {
+#if defined(__GNUC__)
+  return __builtin_ctz(n);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, n);
+  return static_cast<int>(index);
+#else
+  int count = 0;
+  while ((n & 1) == 0) {
+    n >>= 1;
+    ++count;
+  }
+  return count;
+#endif
+}
+
+inline int CountTrailingZeros64(uint64 n) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(n);
+#else
+  const uint32 low = static_cast<uint32>(n);
+  return low != 0 ? CountTrailingZeros32(low)
+                  : 32 + CountTrailingZeros32(static_cast<uint32>(n >> 32));
+#endif
+}
+
+// Decodes a varint whose length is already known to be 1 to 10 bytes.
+template <typename T>
+inline T DecodeVarintOfLength(const uint8* ptr, int length) {
+  uint64 result = 0;
+  for (int i = 0; i < length; i++) {
+    result |= static_cast<uint64>(ptr[i] & 0x7F) << (7 * i);
+  }
+  return static_cast<T>(result);
+}
+
+// Decodes one varint starting at ptr and returns the byte after it, or NULL
+// if it does not end before `end` or is too long (*malformed tells which).
+template <typename T>
+inline const uint8* DecodeOneVarint(const uint8* ptr, const uint8* end,
+                                    T* out, bool* malformed) {
+#ifdef PROTOBUF_LITTLE_ENDIAN
+  if (end - ptr >= 8) {
+    // Find the last byte from the continuation bits of an 8-byte word, then
+    // pack the 7-bit groups before it together with shifts and masks.
+    uint64 x;
+    memcpy(&x, ptr, sizeof(x));
+    // One- and two-byte varints are common enough to be worth a branch,
+    // which also lets the CPU run ahead to the next value.
+    if ((x & 0x80) == 0) {
+      *out = static_cast<T>(x & 0x7F);
+      return ptr + 1;
+    }
+    if ((x & 0x8000) == 0) {
+      *out = static_cast<T>((x & 0x7F) | ((x >> 1) & 0x3F80));
+      return ptr + 2;
+    }
+    const uint64 stops = ~x & GOOGLE_ULONGLONG(0x8080808080808080);
+    if (stops != 0) {
+      x &= (stops ^ (stops - 1)) & GOOGLE_ULONGLONG(0x7F7F7F7F7F7F7F7F);
+      x = ((x & GOOGLE_ULONGLONG(0x7F007F007F007F00)) >> 1) |
+          (x & GOOGLE_ULONGLONG(0x007F007F007F007F));
+      x = ((x & GOOGLE_ULONGLONG(0x3FFF00003FFF0000)) >> 2) |
+          (x & GOOGLE_ULONGLONG(0x00003FFF00003FFF));
+      x = ((x & GOOGLE_ULONGLONG(0x0FFFFFFF00000000)) >> 4) |
+          (x & GOOGLE_ULONGLONG(0x000000000FFFFFFF));
+      *out = static_cast<T>(x);
+      return ptr + (CountTrailingZeros64(stops) >> 3) + 1;
+    }
+  }
+#endif
+  const uint8* limit = end - ptr > 10 ? ptr + 10 : end;
+  for (const uint8* p = ptr; p < limit; p++) {
+    if (*p < 0x80) {
+      *out = DecodeVarintOfLength<T>(ptr, static_cast<int>(p - ptr) + 1);
+      return p + 1;
+    }
+  }
+  *malformed = (limit - ptr == 10);
+  return NULL;
+}
+
+template <typename T>
+int DecodeVarintRunScalar(const uint8* ptr, const uint8* end, T* out,
+                          int max_values, int* consumed) {
+  const uint8* start = ptr;
+  int count = 0;
+  bool malformed = false;
+
+  while (count < max_values) {
+    if (end - ptr >= 8 && max_values - count >= 8) {
+      uint64 word;
+      memcpy(&word, ptr, sizeof(word));
+      if ((word & GOOGLE_ULONGLONG(0x8080808080808080)) == 0) {
+        // Eight one-byte varints.
+        for (int i = 0; i < 8; i++) {
+          out[count + i] = static_cast<T>(ptr[i]);
+        }
+        ptr += 8;
+        count += 8;
+        continue;
+      }
+    }
+    const uint8* next = DecodeOneVarint(ptr, end, out + count, &malformed);
+    if (next == NULL) break;
+    ptr = next;
+    count++;
+  }
+
+  *consumed = static_cast<int>(ptr - start);
+  return malformed ? -1 : count;
+}
+
+// Maps an element to the bits of its varint.  Sign-extended int32 values keep
+// 32 bits here; the callers give negative ones ten bytes.
+template <VarintEncoding E>
+inline uint32 VarintBits(uint32 value) {
+  return value;
+}
+template <VarintEncoding E>
+inline uint32 VarintBits(int32 value) {
+  return E == VARINT_ZIGZAG
+             ? (static_cast<uint32>(value) << 1) ^
+                   static_cast<uint32>(value >> 31)
+             : static_cast<uint32>(value);
+}
+template <VarintEncoding E>
+inline uint64 VarintBits(uint64 value) {
+  return value;
+}
+template <VarintEncoding E>
+inline uint64 VarintBits(int64 value) {
+  return E == VARINT_ZIGZAG
+             ? (static_cast<uint64>(value) << 1) ^
+                   static_cast<uint64>(value >> 63)
+             : static_cast<uint64>(value);
+}
+
+template <VarintEncoding E, typename T>
+inline size_t VarintSizeOf(T value) {
+  if (sizeof(T) == 4) {
+    const uint32 bits = static_cast<uint32>(VarintBits<E>(value));
+    if (E == VARINT_SIGN_EXTENDED) {
+      return CodedOutputStream::VarintSize32SignExtended(
+          static_cast<int32>(bits));
+    }
+    return CodedOutputStream::VarintSize32(bits);
+  }
+  return CodedOutputStream::VarintSize64(
+      static_cast<uint64>(VarintBits<E>(value)));
+}
+
+template <VarintEncoding E, typename T>
+inline uint8* WriteVarintOf(T value, uint8* target) {
+  if (sizeof(T) == 4) {
+    const uint32 bits = static_cast<uint32>(VarintBits<E>(value));
+    if (E == VARINT_SIGN_EXTENDED) {
+      return CodedOutputStream::WriteVarint32SignExtendedToArray(
+          static_cast<int32>(bits), target);
+    }
+    return CodedOutputStream::WriteVarint32ToArray(bits, target);
+  }
+  return CodedOutputStream::WriteVarint64ToArray(
+      static_cast<uint64>(VarintBits<E>(value)), target);
+}
+
+// Like WriteVarintOf(), but stores eight bytes whatever the length, so at
+// least eight bytes must be writable at target.  The 7-bit groups are spread
+// out and the continuation bits set with shifts and masks instead of a loop.
+template <VarintEncoding E, typename T>
+inline uint8* WriteVarintWide(T value, uint8* target) {
+#ifdef PROTOBUF_LITTLE_ENDIAN
+  uint64 x;
+  if (sizeof(T) == 4 && E == VARINT_SIGN_EXTENDED) {
+    x = static_cast<uint64>(static_cast<int64>(static_cast<int32>(
+        VarintBits<E>(value))));
+  } else {
+    x = static_cast<uint64>(VarintBits<E>(value));
+  }
+  if (x < (GOOGLE_ULONGLONG(1) << 56)) {
+    const int length = static_cast<int>(CodedOutputStream::VarintSize64(x));
+    x = (x & GOOGLE_ULONGLONG(0x000000000FFFFFFF)) |
+        ((x & GOOGLE_ULONGLONG(0x00FFFFFFF0000000)) << 4);
+    x = (x & GOOGLE_ULONGLONG(0x00003FFF00003FFF)) |
+        ((x & GOOGLE_ULONGLONG(0x0FFFC0000FFFC000)) << 2);
+    x = (x & GOOGLE_ULONGLONG(0x007F007F007F007F)) |
+        ((x & GOOGLE_ULONGLONG(0x3F803F803F803F80)) << 1);
+    x |= GOOGLE_ULONGLONG(0x8080808080808080) &
+         ((GOOGLE_ULONGLONG(1) << (8 * (length - 1))) - 1);
+    memcpy(target, &x, sizeof(x));
+    return target + length;
+  }
+#endif
+  return WriteVarintOf<E>(value, target);
+}
+
+// Writes data[begin, end) of an array of n values.  Every value takes at
+// least one byte, so one with seven more after it has eight bytes of room.
+template <VarintEncoding E, typename T>
+inline uint8* EncodeVarintSpan(const T* data, int begin, int end, int n,
+                               uint8* target) {
+  const int wide_end = end < n - 7 ? end : n - 7;
+  int i = begin;
+  for (; i < wide_end; i++) {
+    target = WriteVarintWide<E>(data[i], target);
+  }
+  for (; i < end; i++) {
+    target = WriteVarintOf<E>(data[i], target);
+  }
+  return target;
+}
+
+template <VarintEncoding E, typename T>
+size_t VarintRunSizeScalar(const T* data, int n) {
+  size_t size = 0;
+  for (int i = 0; i < n; i++) {
+    size += VarintSizeOf<E>(data[i]);
+  }
+  return size;
+}
+
+template <VarintEncoding E, typename T>
+uint8* EncodeVarintRunScalar(const T* data, int n, uint8* target) {
+  return EncodeVarintSpan<E>(data, 0, n, n, target);
+}
+
+#ifdef GOOGLE_PROTOBUF_BULK_VARINT_X86
+
+// Hands whatever the vector loop left over to the scalar kernel.
+template <typename T>
+inline int FinishVarintRun(const uint8* start, const uint8* ptr,
+                           const uint8* end, T* out, int count,
+                           int max_values, int* consumed) {
+  int tail_consumed = 0;
+  const int tail = DecodeVarintRunScalar(ptr, end, out + count,
+                                         max_values - count, &tail_consumed);
+  if (tail < 0) return -1;
+  *consumed = static_cast<int>(ptr - start) + tail_consumed;
+  return count + tail;
+}
+
+// Decodes the varints starting in the block_size bytes at *ptr one at a time,
+// for blocks that are not all one-byte varints.  Returns false if a varint is
+// too long; at least ten bytes past *ptr are known to be readable.
+template <typename T>
+inline bool DecodeVarintBlock(const uint8** ptr, const uint8* end,
+                              int block_size, T* out, int* count) {
+  const uint8* block_end = *ptr + block_size;
+  bool malformed = false;
+  while (*ptr < block_end) {
+    const uint8* next = DecodeOneVarint(*ptr, end, out + *count, &malformed);
+    if (next == NULL) return !malformed;
+    *ptr = next;
+    ++*count;
+  }
+  return true;
+}
+
+template <typename T>
+GOOGLE_PROTOBUF_TARGET_SSE41 int DecodeVarintRunSse41(
+    const uint8* ptr, const uint8* end, T* out, int max_values,
+    int* consumed) {
+  const uint8* start = ptr;
+  int count = 0;
+
+  while (end - ptr >= 16 && max_values - count >= 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    const uint32 mask = static_cast<uint32>(_mm_movemask_epi8(bytes));
+    if (mask == 0) {
+      // Sixteen one-byte varints.
+      __m128i* dest = reinterpret_cast<__m128i*>(out + count);
+      if (sizeof(T) == 4) {
+        for (int i = 0; i < 4; i++) {
+          _mm_storeu_si128(dest + i, _mm_cvtepu8_epi32(bytes));
+          bytes = _mm_srli_si128(bytes, 4);
+        }
+      } else {
+        for (int i = 0; i < 8; i++) {
+          _mm_storeu_si128(dest + i, _mm_cvtepu8_epi64(bytes));
+          bytes = _mm_srli_si128(bytes, 2);
+        }
+      }
+      ptr += 16;
+      count += 16;
+    } else if (!DecodeVarintBlock(&ptr, end, 16, out, &count)) {
+      return -1;
+    }
+  }
+
+  return FinishVarintRun(start, ptr, end, out, count, max_values, consumed);
+}
+
+template <typename T>
+GOOGLE_PROTOBUF_TARGET_AVX2 int DecodeVarintRunAvx2(
+    const uint8* ptr, const uint8* end, T* out, int max_values,
+    int* consumed) {
+  const uint8* start = ptr;
+  int count = 0;
+
+  while (end - ptr >= 32 && max_values - count >= 32) {
+    const __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+    const uint32 mask = static_cast<uint32>(_mm256_movemask_epi8(bytes));
+    if (mask == 0) {
+      // Thirty-two one-byte varints.
+      __m256i* dest = reinterpret_cast<__m256i*>(out + count);
+      __m128i half = _mm256_castsi256_si128(bytes);
+      for (int h = 0; h < 2; h++) {
+        if (sizeof(T) == 4) {
+          _mm256_storeu_si256(dest++, _mm256_cvtepu8_epi32(half));
+          _mm256_storeu_si256(dest++,
+                              _mm256_cvtepu8_epi32(_mm_srli_si128(half, 8)));
+        } else {
+          for (int i = 0; i < 4; i++) {
+            _mm256_storeu_si256(dest++, _mm256_cvtepu8_epi64(half));
+            half = _mm_srli_si128(half, 4);
+          }
+        }
+        half = _mm256_extracti128_si256(bytes, 1);
+      }
+      ptr += 32;
+      count += 32;
+    } else if (!DecodeVarintBlock(&ptr, end, 32, out, &count)) {
+      return -1;
+    }
+  }
+
+  return FinishVarintRun(start, ptr, end, out, count, max_values, consumed);
+}
+
+// Applies VarintBits() to four 32-bit or two 64-bit lanes.
+template <VarintEncoding E>
+GOOGLE_PROTOBUF_TARGET_SSE41 inline __m128i VarintBits32x4(__m128i v) {
+  if (E == VARINT_ZIGZAG) {
+    return _mm_xor_si128(_mm_slli_epi32(v, 1), _mm_srai_epi32(v, 31));
+  }
+  return v;
+}
+template <VarintEncoding E>
+GOOGLE_PROTOBUF_TARGET_SSE41 inline __m128i VarintBits64x2(__m128i v) {
+  if (E == VARINT_ZIGZAG) {
+    const __m128i sign = _mm_shuffle_epi32(_mm_srai_epi32(v, 31),
+                                           _MM_SHUFFLE(3, 3, 1, 1));
+    return _mm_xor_si128(_mm_slli_epi64(v, 1), sign);
+  }
+  return v;
+}
+
+template <VarintEncoding E, typename T>
+GOOGLE_PROTOBUF_TARGET_SSE41 size_t VarintRunSizeSse41(const T* data, int n) {
+  // Only 32-bit values are sized here; VarintSize64() is already cheap.
+  if (sizeof(T) != 4) return VarintRunSizeScalar<E>(data, n);
+
+  const __m128i ones = _mm_set1_epi32(1);
+  const __m128i fives = _mm_set1_epi32(5);
+  size_t size = 0;
+  int i = 0;
+  while (n - i >= 4) {
+    // A lane grows by at most ten per value, so add the lanes up every
+    // 2^24 values, long before they can overflow.
+    const int stop = i + ((n - i < (1 << 24) ? n - i : (1 << 24)) & ~3);
+    __m128i sum = _mm_setzero_si128();
+    for (; i < stop; i += 4) {
+      const __m128i v = VarintBits32x4<E>(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+      // One byte, plus one for each of bits 7, 14, 21 and 28 and up that is
+      // in use.  Negative sign-extended values take five more.
+      __m128i lanes = ones;
+      lanes = _mm_add_epi32(lanes, _mm_min_epu32(_mm_srli_epi32(v, 7), ones));
+      lanes = _mm_add_epi32(lanes, _mm_min_epu32(_mm_srli_epi32(v, 14), ones));
+      lanes = _mm_add_epi32(lanes, _mm_min_epu32(_mm_srli_epi32(v, 21), ones));
+      lanes = _mm_add_epi32(lanes, _mm_min_epu32(_mm_srli_epi32(v, 28), ones));
+      if (E == VARINT_SIGN_EXTENDED) {
+        lanes = _mm_add_epi32(lanes,
+                              _mm_and_si128(_mm_srai_epi32(v, 31), fives));
+      }
+      sum = _mm_add_epi32(sum, lanes);
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    size += static_cast<uint32>(_mm_cvtsi128_si32(sum));
+  }
+  return size + VarintRunSizeScalar<E>(data + i, n - i);
+}
+
+// Encodes sixteen values at a time.  When all of them are below 128 they are
+// narrowed to bytes and stored at once; otherwise they are written one by
+// one.
+template <VarintEncoding E, typename T>
+GOOGLE_PROTOBUF_TARGET_SSE41 uint8* EncodeVarintRunSse41(const T* data, int n,
+                                                         uint8* target) {
+  int i = 0;
+  for (; n - i >= 16; i += 16) {
+    const __m128i* in = reinterpret_cast<const __m128i*>(data + i);
+    __m128i v[4];
+    if (sizeof(T) == 4) {
+      const __m128i high = _mm_set1_epi32(~0x7F);
+      for (int j = 0; j < 4; j++) {
+        v[j] = VarintBits32x4<E>(_mm_loadu_si128(in + j));
+      }
+      const __m128i any = _mm_or_si128(_mm_or_si128(v[0], v[1]),
+                                       _mm_or_si128(v[2], v[3]));
+      if (!_mm_testz_si128(any, high)) {
+        target = EncodeVarintSpan<E>(data, i, i + 16, n, target);
+        continue;
+      }
+    } else {
+      const __m128i high = _mm_set_epi32(-1, ~0x7F, -1, ~0x7F);
+      __m128i any = _mm_setzero_si128();
+      for (int j = 0; j < 4; j++) {
+        // Each pair of values below 128 fits in the low halves of its lanes.
+        const __m128i lo = VarintBits64x2<E>(_mm_loadu_si128(in + 2 * j));
+        const __m128i hi = VarintBits64x2<E>(_mm_loadu_si128(in + 2 * j + 1));
+        any = _mm_or_si128(any, _mm_or_si128(lo, hi));
+        v[j] = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo),
+                                               _mm_castsi128_ps(hi),
+                                               _MM_SHUFFLE(2, 0, 2, 0)));
+      }
+      if (!_mm_testz_si128(any, high)) {
+        target = EncodeVarintSpan<E>(data, i, i + 16, n, target);
+        continue;
+      }
+    }
+    const __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(v[0], v[1]),
+                                           _mm_packus_epi32(v[2], v[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(target), bytes);
+    target += 16;
+  }
+  return EncodeVarintSpan<E>(data, i, n, n, target);
+}
+
+#endif  // GOOGLE_PROTOBUF_BULK_VARINT_X86
+
+template <typename T>
+int DecodeVarintRun(BulkVarintKernel kernel, const uint8* ptr,
+                    const uint8* end, T* out, int max_values, int* consumed) {
+#ifdef GOOGLE_PROTOBUF_BULK_VARINT_X86
+  switch (kernel) {
+    case BULK_VARINT_AVX2:
+      return DecodeVarintRunAvx2(ptr, end, out, max_values, consumed);
+    case BULK_VARINT_SSE41:
+      return DecodeVarintRunSse41(ptr, end, out, max_values, consumed);
+    default:
+      break;
+  }
+#endif
+  return DecodeVarintRunScalar(ptr, end, out, max_values, consumed);
+}
+
+template <VarintEncoding E, typename T>
+size_t VarintRunSize(BulkVarintKernel kernel, const T* data, int n) {
+#ifdef GOOGLE_PROTOBUF_BULK_VARINT_X86
+  if (kernel >= BULK_VARINT_SSE41) return VarintRunSizeSse41<E>(data, n);
+#endif
+  return VarintRunSizeScalar<E>(data, n);
+}
+
+template <VarintEncoding E, typename T>
+uint8* EncodeVarintRun(BulkVarintKernel kernel, const T* data, int n,
+                       uint8* target) {
+#ifdef GOOGLE_PROTOBUF_BULK_VARINT_X86
+  if (kernel >= BULK_VARINT_SSE41) {
+    return EncodeVarintRunSse41<E>(data, n, target);
+  }
+#endif
+  return EncodeVarintRunScalar<E>(data, n, target);
+}
+
+}  // namespace internal
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#endif  // GOOGLE_PROTOBUF_IO_BULK_VARINT_H__
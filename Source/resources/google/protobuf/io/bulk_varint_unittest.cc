@@ -0,0 +1,249 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// This file contains tests for the bulk varint decoders, encoders and size
+// calculators, and for the packed-field reader built on them.
+
+#include <string>
+#include <vector>
+
+#include <google/protobuf/io/bulk_varint.h>
+
+#include <google/protobuf/stubs/common.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/repeated_field.h>
+#include <google/protobuf/wire_format_lite_inl.h>
+#include <gtest/gtest.h>
+
+namespace google {
+namespace protobuf {
+namespace io {
+namespace {
+
+using internal::BulkVarintKernel;
+using internal::DecodeVarintRun;
+using internal::EncodeVarintRun;
+using internal::VarintRunSize;
+using google::protobuf::internal::WireFormatLite;
+
+// Small deterministic generator, so failures reproduce.
+class Random {
+ public:
+  explicit Random(uint64 seed) : state_(seed) {}
+  uint64 Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+  // Mostly one-byte values, with some of every other length.
+  uint64 NextValue(int percent_small) {
+    if (static_cast<int>(Next() % 100) < percent_small) return Next() % 128;
+    return Next() >> (Next() % 64);
+  }
+
+ private:
+  uint64 state_;
+};
+
+void AppendVarint(uint64 value, string* output) {
+  uint8 buffer[10];
+  const uint8* end = CodedOutputStream::WriteVarint64ToArray(value, buffer);
+  output->append(reinterpret_cast<const char*>(buffer), end - buffer);
+}
+
+std::vector<BulkVarintKernel> SupportedKernels() {
+  std::vector<BulkVarintKernel> kernels;
+  for (int k = internal::BULK_VARINT_SCALAR;
+       k <= internal::BestBulkVarintKernel(); k++) {
+    kernels.push_back(static_cast<BulkVarintKernel>(k));
+  }
+  return kernels;
+}
+
+// Checks every kernel against CodedInputStream, cutting the input at every
+// offset so that runs end both on and inside a varint.
+template <typename T>
+void CheckAgainstCodedInputStream(const string& data, int max_values) {
+  const uint8* begin = reinterpret_cast<const uint8*>(data.data());
+  const std::vector<BulkVarintKernel> kernels = SupportedKernels();
+
+  for (int cut = 0; cut <= static_cast<int>(data.size()); cut++) {
+    std::vector<T> expected;
+    int expected_bytes = 0;
+    CodedInputStream input(begin, cut);
+    while (static_cast<int>(expected.size()) < max_values) {
+      uint64 value;
+      if (!input.ReadVarint64(&value)) break;
+      expected.push_back(static_cast<T>(value));
+      expected_bytes = input.CurrentPosition();
+    }
+
+    for (size_t k = 0; k < kernels.size(); k++) {
+      SCOPED_TRACE(internal::BulkVarintKernelName(kernels[k]));
+      std::vector<T> output(max_values);
+      int consumed = -1;
+      const int count = DecodeVarintRun(kernels[k], begin, begin + cut,
+                                        output.data(), max_values, &consumed);
+      ASSERT_EQ(static_cast<int>(expected.size()), count) << "cut " << cut;
+      EXPECT_EQ(expected_bytes, consumed) << "cut " << cut;
+      for (int i = 0; i < count; i++) {
+        EXPECT_EQ(expected[i], output[i]) << "value " << i;
+      }
+    }
+  }
+}
+
+TEST(BulkVarintTest, MatchesCodedInputStream) {
+  Random random(1234);
+  const int kPercentSmall[] = { 100, 95, 50, 0 };
+  for (size_t i = 0; i < GOOGLE_ARRAYSIZE(kPercentSmall); i++) {
+    string data;
+    for (int j = 0; j < 150; j++) {
+      AppendVarint(random.NextValue(kPercentSmall[i]), &data);
+    }
+    CheckAgainstCodedInputStream<uint32>(data, 200);
+    CheckAgainstCodedInputStream<uint64>(data, 200);
+    CheckAgainstCodedInputStream<uint64>(data, 37);
+  }
+}
+
+TEST(BulkVarintTest, RejectsOverlongVarint) {
+  string data(40, '\x01');
+  data.append(11, '\x81');
+  data.append(40, '\x01');
+  const uint8* begin = reinterpret_cast<const uint8*>(data.data());
+  const std::vector<BulkVarintKernel> kernels = SupportedKernels();
+  for (size_t k = 0; k < kernels.size(); k++) {
+    SCOPED_TRACE(internal::BulkVarintKernelName(kernels[k]));
+    uint64 output[100];
+    int consumed;
+    EXPECT_EQ(-1, DecodeVarintRun(kernels[k], begin, begin + data.size(),
+                                  output, 100, &consumed));
+  }
+}
+
+TEST(BulkVarintTest, ReadPackedPrimitiveAcrossBuffers) {
+  Random random(5678);
+  string payload;
+  std::vector<int32> expected;
+  for (int i = 0; i < 1000; i++) {
+    const int32 value = static_cast<int32>(random.NextValue(80)) >> 1;
+    AppendVarint(WireFormatLite::ZigZagEncode32(value), &payload);
+    expected.push_back(value);
+  }
+  string data;
+  AppendVarint(payload.size(), &data);
+  data.append(payload);
+  data.append("end");
+
+  // Small blocks make values straddle buffer boundaries.
+  const int kBlockSizes[] = { 1, 7, 16, 33, 4096 };
+  for (size_t i = 0; i < GOOGLE_ARRAYSIZE(kBlockSizes); i++) {
+    ArrayInputStream stream(data.data(), data.size(), kBlockSizes[i]);
+    CodedInputStream input(&stream);
+    RepeatedField<int32> values;
+    ASSERT_TRUE((WireFormatLite::ReadPackedPrimitive<
+                 int32, WireFormatLite::TYPE_SINT32>(&input, &values)));
+    ASSERT_EQ(expected.size(), values.size());
+    for (int j = 0; j < values.size(); j++) {
+      EXPECT_EQ(expected[j], values.Get(j));
+    }
+    string rest;
+    EXPECT_TRUE(input.ReadString(&rest, 3));
+    EXPECT_EQ("end", rest);
+  }
+}
+
+// Checks every kernel's size and encoding of values against the ones
+// CodedOutputStream gives for `expected`, with the output buffer sized exactly
+// and followed by guard bytes that must stay untouched.
+template <internal::VarintEncoding E, typename T>
+void CheckEncoding(const std::vector<T>& values, const string& expected) {
+  const std::vector<BulkVarintKernel> kernels = SupportedKernels();
+  const int n = static_cast<int>(values.size());
+  for (size_t k = 0; k < kernels.size(); k++) {
+    SCOPED_TRACE(internal::BulkVarintKernelName(kernels[k]));
+    EXPECT_EQ(expected.size(),
+              VarintRunSize<E>(kernels[k], values.data(), n));
+
+    string output(expected.size() + 16, '\xAA');
+    uint8* begin = reinterpret_cast<uint8*>(&output[0]);
+    uint8* end = EncodeVarintRun<E>(kernels[k], values.data(), n, begin);
+    EXPECT_EQ(expected.size(), end - begin);
+    EXPECT_EQ(expected, output.substr(0, expected.size()));
+    EXPECT_EQ(string(16, '\xAA'), output.substr(expected.size()));
+  }
+}
+
+TEST(BulkVarintTest, EncodesLikeCodedOutputStream) {
+  Random random(4321);
+  const int kPercentSmall[] = { 100, 95, 50, 0 };
+  const int kCounts[] = { 0, 1, 7, 8, 15, 16, 17, 100 };
+  for (size_t i = 0; i < GOOGLE_ARRAYSIZE(kPercentSmall); i++) {
+    for (size_t j = 0; j < GOOGLE_ARRAYSIZE(kCounts); j++) {
+      std::vector<int32> int32s;
+      std::vector<uint32> uint32s;
+      std::vector<int64> int64s;
+      std::vector<uint64> uint64s;
+      string int32_wire, uint32_wire, sint32_wire;
+      string int64_wire, uint64_wire, sint64_wire;
+      for (int v = 0; v < kCounts[j]; v++) {
+        uint64 value = random.NextValue(kPercentSmall[i]);
+        if (random.Next() % 4 == 0) value = ~value + 1;  // negative
+        int32s.push_back(static_cast<int32>(value));
+        uint32s.push_back(static_cast<uint32>(value));
+        int64s.push_back(static_cast<int64>(value));
+        uint64s.push_back(value);
+        AppendVarint(static_cast<uint64>(static_cast<int64>(int32s.back())),
+                     &int32_wire);
+        AppendVarint(uint32s.back(), &uint32_wire);
+        AppendVarint(WireFormatLite::ZigZagEncode32(int32s.back()),
+                     &sint32_wire);
+        AppendVarint(value, &int64_wire);
+        AppendVarint(value, &uint64_wire);
+        AppendVarint(WireFormatLite::ZigZagEncode64(int64s.back()),
+                     &sint64_wire);
+      }
+      CheckEncoding<internal::VARINT_SIGN_EXTENDED>(int32s, int32_wire);
+      CheckEncoding<internal::VARINT_UNSIGNED>(uint32s, uint32_wire);
+      CheckEncoding<internal::VARINT_ZIGZAG>(int32s, sint32_wire);
+      CheckEncoding<internal::VARINT_SIGN_EXTENDED>(int64s, int64_wire);
+      CheckEncoding<internal::VARINT_UNSIGNED>(uint64s, uint64_wire);
+      CheckEncoding<internal::VARINT_ZIGZAG>(int64s, sint64_wire);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
@@ -108,7 +108,7 @@ inline int CalculateReserve(Iter begin, Iter end) {
 // not ever use a RepeatedField directly; they will use the get-by-index,
 // set-by-index, and add accessors that are generated for all repeated fields.
 template <typename Element>
-class RepeatedField PROTOBUF_FINAL {
+class RepeatedField {
  public:
   RepeatedField();
   explicit RepeatedField(Arena* arena);
@@ -256,6 +256,12 @@ class RepeatedField PROTOBUF_FINAL {
   // This is public due to it being called by generated code.
   inline void InternalSwap(RepeatedField* other);
 
+ protected:
+  // For InlinedRepeatedField: makes |rep|, which must have room for the arena
+  // pointer and |capacity| elements and live as long as this field, its first
+  // storage.
+  void InitInlineRep(void* rep, int capacity, Arena* arena);
+
  private:
   static const int kInitialSize = 0;
   // A note on the representation here (see also comment below for
@@ -283,6 +289,14 @@ class RepeatedField PROTOBUF_FINAL {
   // if rep_ is NULL, then arena is NULL.
   Rep* rep_;
 
+  // Set in Rep::arena when the Rep is the inline storage of an
+  // InlinedRepeatedField, which must neither be freed nor change owners.
+  static const intptr_t kInlineRepTag = 1;
+  static bool IsInlineRep(const Rep* rep) {
+    return rep != NULL &&
+           (reinterpret_cast<intptr_t>(rep->arena) & kInlineRepTag) != 0;
+  }
+
   friend class Arena;
   typedef void InternalArenaConstructable_;
 
@@ -297,7 +311,8 @@ class RepeatedField PROTOBUF_FINAL {
 
   // Internal helper expected by Arena methods.
   inline Arena* GetArenaNoVirtual() const {
-    return (rep_ == NULL) ? NULL : rep_->arena;
+    return (rep_ == NULL) ? NULL : reinterpret_cast<Arena*>(
+        reinterpret_cast<intptr_t>(rep_->arena) & ~kInlineRepTag);
   }
 
   // Internal helper to delete all elements and deallocate the storage.
@@ -329,6 +344,39 @@ template<typename Element>
 const size_t RepeatedField<Element>::kRepHeaderSize =
     reinterpret_cast<size_t>(&reinterpret_cast<Rep*>(16)->elements[0]) - 16;
 
+// InlinedRepeatedField is a RepeatedField with room for kInlineSize elements
+// inside the object itself, so that it does not allocate until it grows past
+// them; from then on it behaves like any RepeatedField. The C++ code generator
+// uses it for repeated fields with the (google.protobuf.cpp_inline_size)
+// option (see cpp_field_options.proto). Element must be a primitive type.
+template <typename Element, int kInlineSize>
+class InlinedRepeatedField : public RepeatedField<Element> {
+ public:
+  InlinedRepeatedField() { Init(NULL); }
+  explicit InlinedRepeatedField(Arena* arena) { Init(arena); }
+  InlinedRepeatedField(const InlinedRepeatedField& other) {
+    Init(NULL);
+    this->MergeFrom(other);
+  }
+
+  InlinedRepeatedField& operator=(const InlinedRepeatedField& other) {
+    if (this != &other) this->CopyFrom(other);
+    return *this;
+  }
+
+ private:
+  // Same layout as RepeatedField<Element>::Rep.
+  struct InlineRep {
+    Arena* arena;
+    Element elements[kInlineSize];
+  };
+  InlineRep inline_rep_;
+
+  void Init(Arena* arena) {
+    this->InitInlineRep(&inline_rep_, kInlineSize, arena);
+  }
+};
+
 namespace internal {
 template <typename It> class RepeatedPtrIterator;
 template <typename It, typename VoidPtr> class RepeatedPtrOverPtrsIterator;
@@ -1296,6 +1344,13 @@ inline void RepeatedField<Element>::InternalSwap(RepeatedField* other) {
   GOOGLE_DCHECK(this != other);
   GOOGLE_DCHECK(GetArenaNoVirtual() == other->GetArenaNoVirtual());
 
+  if (IsInlineRep(rep_) || IsInlineRep(other->rep_)) {
+    // Inline storage stays with its owner, so swap the contents instead.
+    RepeatedField<Element> temp(*this);
+    CopyFrom(*other);
+    other->CopyFrom(temp);
+    return;
+  }
   std::swap(rep_, other->rep_);
   std::swap(current_size_, other->current_size_);
   std::swap(total_size_, other->total_size_);
@@ -1359,7 +1414,18 @@ RepeatedField<Element>::cend() const {
 
 template <typename Element>
 inline size_t RepeatedField<Element>::SpaceUsedExcludingSelfLong() const {
-  return rep_ ? (total_size_ * sizeof(Element) + kRepHeaderSize) : 0;
+  return rep_ && !IsInlineRep(rep_) ?
+      (total_size_ * sizeof(Element) + kRepHeaderSize) : 0;
+}
+
+template <typename Element>
+inline void RepeatedField<Element>::InitInlineRep(void* rep, int capacity,
+                                                  Arena* arena) {
+  GOOGLE_DCHECK(rep_ == NULL);
+  rep_ = static_cast<Rep*>(rep);
+  rep_->arena = reinterpret_cast<Arena*>(
+      reinterpret_cast<intptr_t>(arena) | kInlineRepTag);
+  total_size_ = capacity;
 }
 
 // Avoid inlining of Reserve(): new, copy, and delete[] lead to a significant
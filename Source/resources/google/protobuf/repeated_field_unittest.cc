@@ -621,6 +621,103 @@ TEST(RepeatedField, ClearThenReserveMore) {
   // strings.
 }
 
+TEST(InlinedRepeatedField, Small) {
+  InlinedRepeatedField<int, 4> field;
+  const char* begin = reinterpret_cast<const char*>(&field);
+  const char* end = begin + sizeof(field);
+
+  EXPECT_TRUE(field.empty());
+  EXPECT_EQ(4, field.Capacity());
+  for (int i = 0; i < 4; i++) {
+    field.Add(i * 3);
+  }
+  EXPECT_THAT(field, ElementsAre(0, 3, 6, 9));
+
+  // The elements live inside the field itself.
+  const char* data = reinterpret_cast<const char*>(field.data());
+  EXPECT_TRUE(data >= begin && data < end);
+  EXPECT_EQ(4, field.Capacity());
+  EXPECT_EQ(0, field.SpaceUsedExcludingSelfLong());
+  EXPECT_TRUE(field.GetArena() == NULL);
+}
+
+TEST(InlinedRepeatedField, GrowsPastInlineStorage) {
+  InlinedRepeatedField<int, 4> field;
+  for (int i = 0; i < 10; i++) {
+    field.Add(i);
+  }
+  EXPECT_EQ(10, field.size());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(i, field.Get(i));
+  }
+  EXPECT_LE(10, field.Capacity());
+  EXPECT_LT(0, field.SpaceUsedExcludingSelfLong());
+
+  // Clearing keeps the out-of-line storage, like RepeatedField.
+  field.Clear();
+  EXPECT_LE(10, field.Capacity());
+}
+
+TEST(InlinedRepeatedField, Swap) {
+  InlinedRepeatedField<int, 4> field1;
+  InlinedRepeatedField<int, 4> field2;
+  RepeatedField<int> field3;
+  field1.Add(1);
+  field1.Add(2);
+  field2.Add(3);
+  for (int i = 0; i < 6; i++) {
+    field3.Add(10 + i);
+  }
+
+  field1.Swap(&field2);
+  EXPECT_THAT(field1, ElementsAre(3));
+  EXPECT_THAT(field2, ElementsAre(1, 2));
+
+  field1.Swap(&field3);
+  EXPECT_THAT(field1, ElementsAre(10, 11, 12, 13, 14, 15));
+  EXPECT_THAT(field3, ElementsAre(3));
+
+  field3.Swap(&field2);
+  EXPECT_THAT(field2, ElementsAre(3));
+  EXPECT_THAT(field3, ElementsAre(1, 2));
+}
+
+TEST(InlinedRepeatedField, CopyConstructAndAssign) {
+  InlinedRepeatedField<int, 2> source;
+  source.Add(1);
+  source.Add(2);
+  source.Add(3);
+
+  InlinedRepeatedField<int, 2> copy(source);
+  EXPECT_THAT(copy, ElementsAre(1, 2, 3));
+
+  InlinedRepeatedField<int, 2> assigned;
+  assigned.Add(4);
+  assigned = source;
+  EXPECT_THAT(assigned, ElementsAre(1, 2, 3));
+
+  RepeatedField<int> plain(source);
+  EXPECT_THAT(plain, ElementsAre(1, 2, 3));
+}
+
+TEST(InlinedRepeatedField, Arena) {
+  Arena arena;
+  InlinedRepeatedField<int64, 4>* field =
+      Arena::Create<InlinedRepeatedField<int64, 4> >(&arena, &arena);
+  uint64 space_used = arena.SpaceUsed();
+  EXPECT_EQ(&arena, field->GetArena());
+  for (int i = 0; i < 4; i++) {
+    field->Add(i);
+  }
+  EXPECT_EQ(space_used, arena.SpaceUsed());
+
+  // Growing past the inline storage allocates from the arena.
+  field->Add(4);
+  EXPECT_LT(space_used, arena.SpaceUsed());
+  EXPECT_EQ(&arena, field->GetArena());
+  EXPECT_THAT(*field, ElementsAre(0, 1, 2, 3, 4));
+}
+
 // ===================================================================
 // RepeatedPtrField tests.  These pretty much just mirror the RepeatedField
 // tests above.
@@ -34,9 +34,6 @@
 
 #include <google/protobuf/wire_format_lite_inl.h>
 
-#ifdef __SSE_4_1__
-#include <immintrin.h>
-#endif
 #include <stack>
 #include <string>
 #include <vector>
@@ -432,6 +429,56 @@ void WireFormatLite::WriteBoolArray(const bool* a, int n,
   WriteArray<bool>(a, n, output);
 }
 
+// Encodes a chunk of values at a time into a stack buffer; the buffer is
+// then written to the stream in one piece.
+template <io::internal::VarintEncoding Encoding, typename CType>
+static void WriteVarintArray(const CType* a, int n,
+                             io::CodedOutputStream* output) {
+  const int kAtATime = 128;
+  const int kMaxVarintBytes = 10;
+  uint8 buf[kMaxVarintBytes * kAtATime];
+  for (int i = 0; i < n; i += kAtATime) {
+    int to_do = std::min(kAtATime, n - i);
+    uint8* end = io::internal::EncodeVarintRun<Encoding>(a + i, to_do, buf);
+    output->WriteRaw(buf, static_cast<int>(end - buf));
+  }
+}
+
+void WireFormatLite::WriteInt32Array(const int32* a, int n,
+                                     io::CodedOutputStream* output) {
+  WriteVarintArray<io::internal::VARINT_SIGN_EXTENDED>(a, n, output);
+}
+
+void WireFormatLite::WriteInt64Array(const int64* a, int n,
+                                     io::CodedOutputStream* output) {
+  WriteVarintArray<io::internal::VARINT_SIGN_EXTENDED>(a, n, output);
+}
+
+void WireFormatLite::WriteUInt32Array(const uint32* a, int n,
+                                      io::CodedOutputStream* output) {
+  WriteVarintArray<io::internal::VARINT_UNSIGNED>(a, n, output);
+}
+
+void WireFormatLite::WriteUInt64Array(const uint64* a, int n,
+                                      io::CodedOutputStream* output) {
+  WriteVarintArray<io::internal::VARINT_UNSIGNED>(a, n, output);
+}
+
+void WireFormatLite::WriteSInt32Array(const int32* a, int n,
+                                      io::CodedOutputStream* output) {
+  WriteVarintArray<io::internal::VARINT_ZIGZAG>(a, n, output);
+}
+
+void WireFormatLite::WriteSInt64Array(const int64* a, int n,
+                                      io::CodedOutputStream* output) {
+  WriteVarintArray<io::internal::VARINT_ZIGZAG>(a, n, output);
+}
+
+void WireFormatLite::WriteEnumArray(const int* a, int n,
+                                    io::CodedOutputStream* output) {
+  WriteVarintArray<io::internal::VARINT_SIGN_EXTENDED>(a, n, output);
+}
+
 void WireFormatLite::WriteInt32(int field_number, int32 value,
                                 io::CodedOutputStream* output) {
   WriteTag(field_number, WIRETYPE_VARINT, output);
@@ -635,152 +682,27 @@ bool WireFormatLite::VerifyUtf8String(const char* data,
   return true;
 }
 
-#ifdef __SSE_4_1__
-template<typename T, bool ZigZag, bool SignExtended>
-static size_t VarintSize(
-    const T* data, const int n,
-    const internal::enable_if<sizeof(T) == 4>::type* = NULL) {
-#if __cplusplus >= 201103L
-  // is_unsigned<T> => !ZigZag
-  static_assert((std::is_unsigned<T>::value ^ ZigZag) ||
-                std::is_signed<T>::value,
-                "Cannot ZigZag encode unsigned types");
-  // is_unsigned<T> => !SignExtended
-  static_assert((std::is_unsigned<T>::value ^ SignExtended) ||
-                std::is_signed<T>::value,
-                "Cannot SignExtended unsigned types");
-#endif
-
-  union vus32 {
-    uint32  u[4];
-    int32   s[4];
-    __m128i v;
-  };
-
-  static const vus32 ones = {{1, 1, 1, 1}};
-
-  // CodedOutputStream::VarintSize32SignExtended returns 10 for negative
-  // numbers.  We can apply the UInt32Size algorithm, and simultaneously logical
-  // shift the MSB into the LSB to determine if it is negative.
-  static const vus32 fives = {{5, 5, 5, 5}};
-
-  // sum is the vectorized-output of calling CodedOutputStream::VarintSize32 on
-  // the processed elements.
-  //
-  // msb_sum is the count of set most-significant bits.  When computing the
-  // vectorized CodedOutputStream::VarintSize32SignExtended, negative values
-  // have the most significant bit set.  VarintSize32SignExtended returns 10 and
-  // VarintSize32 returns 5.  msb_sum allows us to compute:
-  //   VarintSize32SignExtended = msb_sum * 5 + VarintSize32
-  vus32 sum, v, msb_sum;
-  sum.v = _mm_setzero_si128();
-  msb_sum.v = _mm_setzero_si128();
-
-  int rounded = n & ~(3);
-  int i;
-  for (i = 0; i < rounded; i += 4) {
-    v.v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i]));
-
-    if (ZigZag) {
-      // Note:  the right-shift must be arithmetic
-      v.v = _mm_xor_si128(_mm_slli_epi32(v.v, 1), _mm_srai_epi32(v.v, 31));
-    }
-
-    sum.v = _mm_add_epi32(sum.v, ones.v);
-    if (SignExtended) {
-      msb_sum.v = _mm_add_epi32(msb_sum.v, _mm_srli_epi32(v.v, 31));
-    }
-
-    v.v = _mm_srli_epi32(v.v, 7);
-
-    for (int j = 0; j < 4; j++) {
-      __m128i min = _mm_min_epi32(v.v, ones.v);
-
-      sum.v = _mm_add_epi32(sum.v, min);
-      v.v   = _mm_srli_epi32(v.v, 7);
-    }
-  }
-
-  if (SignExtended) {
-    vus32 extensions;
-    extensions.v = _mm_mullo_epi32(msb_sum.v, fives.v);
-
-    sum.v = _mm_add_epi32(sum.v, extensions.v);
-  }
-
-  // TODO(ckennelly): Can we avoid the sign conversion?
-  size_t out = _mm_cvtsi128_si32(
-      _mm_hadd_epi32(_mm_hadd_epi32(sum.v, ones.v), ones.v));
-
-  // Finish tail.
-  for (; i < n; i++) {
-    if (ZigZag) {
-      out += WireFormatLite::SInt32Size(data[i]);
-    } else if (SignExtended) {
-      out += WireFormatLite::Int32Size(data[i]);
-    } else {
-      out += WireFormatLite::UInt32Size(data[i]);
-    }
-  }
-
-  return out;
-}
-
 size_t WireFormatLite::Int32Size(const RepeatedField<int32>& value) {
-  return VarintSize<int32, false, true>(value.data(), value.size());
+  return io::internal::VarintRunSize<io::internal::VARINT_SIGN_EXTENDED>(
+      value.data(), value.size());
 }
 
 size_t WireFormatLite::UInt32Size(const RepeatedField<uint32>& value) {
-  return VarintSize<uint32, false, false>(value.data(), value.size());
+  return io::internal::VarintRunSize<io::internal::VARINT_UNSIGNED>(
+      value.data(), value.size());
 }
 
 size_t WireFormatLite::SInt32Size(const RepeatedField<int32>& value) {
-  return VarintSize<int32, true, true>(value.data(), value.size());
+  return io::internal::VarintRunSize<io::internal::VARINT_ZIGZAG>(
+      value.data(), value.size());
 }
 
 size_t WireFormatLite::EnumSize(const RepeatedField<int>& value) {
-  // On ILP64, sizeof(int) == 8, which would require a different template.
-  return VarintSize<int, false, true>(value.data(), value.size());
+  // On ILP64, sizeof(int) == 8, which would need the 64-bit kernels.
+  return io::internal::VarintRunSize<io::internal::VARINT_SIGN_EXTENDED>(
+      value.data(), value.size());
 }
 
-#else  // !__SSE_4_1__
-size_t WireFormatLite::Int32Size(const RepeatedField<int32>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += Int32Size(value.Get(i));
-  }
-  return out;
-}
-
-size_t WireFormatLite::UInt32Size(const RepeatedField<uint32>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += UInt32Size(value.Get(i));
-  }
-  return out;
-}
-
-size_t WireFormatLite::SInt32Size(const RepeatedField<int32>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += SInt32Size(value.Get(i));
-  }
-  return out;
-}
-
-size_t WireFormatLite::EnumSize(const RepeatedField<int>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += EnumSize(value.Get(i));
-  }
-  return out;
-}
-#endif
-
 }  // namespace internal
 }  // namespace protobuf
 }  // namespace google
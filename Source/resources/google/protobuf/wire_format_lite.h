@@ -414,6 +414,20 @@ class LIBPROTOBUF_EXPORT WireFormatLite {
                                  io::CodedOutputStream* output);
   static void WriteBoolArray(const bool* a, int n,
                              io::CodedOutputStream* output);
+  static void WriteInt32Array(const int32* a, int n,
+                              io::CodedOutputStream* output);
+  static void WriteInt64Array(const int64* a, int n,
+                              io::CodedOutputStream* output);
+  static void WriteUInt32Array(const uint32* a, int n,
+                               io::CodedOutputStream* output);
+  static void WriteUInt64Array(const uint64* a, int n,
+                               io::CodedOutputStream* output);
+  static void WriteSInt32Array(const int32* a, int n,
+                               io::CodedOutputStream* output);
+  static void WriteSInt64Array(const int64* a, int n,
+                               io::CodedOutputStream* output);
+  static void WriteEnumArray(const int* a, int n,
+                             io::CodedOutputStream* output);
 
   // Write fields, including tags.
   static void WriteInt32(int field_number, int32 value,
@@ -44,6 +44,7 @@
 #include <google/protobuf/repeated_field.h>
 #include <google/protobuf/wire_format_lite.h>
 #include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/bulk_varint.h>
 #include <google/protobuf/arenastring.h>
 
 
@@ -323,13 +324,66 @@ bool WireFormatLite::ReadRepeatedPrimitiveNoInline(
       tag_size, tag, input, value);
 }
 
+// For each varint field type, the width its wire value is decoded at in bulk
+// and how that becomes the field's value; these match ReadPrimitive() above.
+template <typename CType, enum WireFormatLite::FieldType DeclaredType>
+struct PackedVarintTraits;
+
+#define PACKED_VARINT_TRAITS(CPPTYPE, DECLARED_TYPE, WIRETYPE, CONVERT)        \
+template <>                                                                    \
+struct PackedVarintTraits<CPPTYPE, WireFormatLite::DECLARED_TYPE> {            \
+  typedef WIRETYPE WireType;                                                   \
+  static inline CPPTYPE Convert(WIRETYPE value) { return CONVERT; }            \
+};
+
+PACKED_VARINT_TRAITS(int32, TYPE_INT32, uint32, static_cast<int32>(value))
+PACKED_VARINT_TRAITS(int64, TYPE_INT64, uint64, static_cast<int64>(value))
+PACKED_VARINT_TRAITS(uint32, TYPE_UINT32, uint32, value)
+PACKED_VARINT_TRAITS(uint64, TYPE_UINT64, uint64, value)
+PACKED_VARINT_TRAITS(int32, TYPE_SINT32, uint32,
+                     WireFormatLite::ZigZagDecode32(value))
+PACKED_VARINT_TRAITS(int64, TYPE_SINT64, uint64,
+                     WireFormatLite::ZigZagDecode64(value))
+PACKED_VARINT_TRAITS(int, TYPE_ENUM, uint32, static_cast<int>(value))
+PACKED_VARINT_TRAITS(bool, TYPE_BOOL, uint64, value != 0)
+
+#undef PACKED_VARINT_TRAITS
+
 template <typename CType, enum WireFormatLite::FieldType DeclaredType>
 inline bool WireFormatLite::ReadPackedPrimitive(io::CodedInputStream* input,
                                                 RepeatedField<CType>* values) {
+  typedef typename PackedVarintTraits<CType, DeclaredType>::WireType WireType;
+  // Fields shorter than this gain nothing from bulk decoding.
+  static const int kMinBulkBytes = 16;
+  static const int kChunkValues = 64;
+
   int length;
   if (!input->ReadVarintSizeAsInt(&length)) return false;
   io::CodedInputStream::Limit limit = input->PushLimit(length);
   while (input->BytesUntilLimit() > 0) {
+    // Decode whatever is already buffered a chunk at a time.  Only a value
+    // straddling the end of the buffer, or a short field, is read one by one.
+    const void* void_pointer;
+    int size;
+    input->GetDirectBufferPointerInline(&void_pointer, &size);
+    if (size >= kMinBulkBytes) {
+      const uint8* buffer = reinterpret_cast<const uint8*>(void_pointer);
+      WireType decoded[kChunkValues];
+      int consumed;
+      const int count = io::internal::DecodeVarintRun(
+          buffer, buffer + size, decoded, kChunkValues, &consumed);
+      if (count < 0) return false;
+      if (count > 0) {
+        values->Reserve(values->size() + count);
+        CType* dest = values->AddNAlreadyReserved(count);
+        for (int i = 0; i < count; i++) {
+          dest[i] = PackedVarintTraits<CType, DeclaredType>::Convert(
+              decoded[i]);
+        }
+        input->Skip(consumed);
+        continue;
+      }
+    }
     CType value;
     if (!ReadPrimitive<CType, DeclaredType>(input, &value)) return false;
     values->Add(value);
@@ -704,27 +758,33 @@ inline uint8* WireFormatLite::WriteFixedNoTagToArray(
 
 inline uint8* WireFormatLite::WriteInt32NoTagToArray(
     const RepeatedField< int32>& value, uint8* target) {
-  return WritePrimitiveNoTagToArray(value, WriteInt32NoTagToArray, target);
+  return io::internal::EncodeVarintRun<io::internal::VARINT_SIGN_EXTENDED>(
+      value.unsafe_data(), value.size(), target);
 }
 inline uint8* WireFormatLite::WriteInt64NoTagToArray(
     const RepeatedField< int64>& value, uint8* target) {
-  return WritePrimitiveNoTagToArray(value, WriteInt64NoTagToArray, target);
+  return io::internal::EncodeVarintRun<io::internal::VARINT_SIGN_EXTENDED>(
+      value.unsafe_data(), value.size(), target);
 }
 inline uint8* WireFormatLite::WriteUInt32NoTagToArray(
     const RepeatedField<uint32>& value, uint8* target) {
-  return WritePrimitiveNoTagToArray(value, WriteUInt32NoTagToArray, target);
+  return io::internal::EncodeVarintRun<io::internal::VARINT_UNSIGNED>(
+      value.unsafe_data(), value.size(), target);
 }
 inline uint8* WireFormatLite::WriteUInt64NoTagToArray(
     const RepeatedField<uint64>& value, uint8* target) {
-  return WritePrimitiveNoTagToArray(value, WriteUInt64NoTagToArray, target);
+  return io::internal::EncodeVarintRun<io::internal::VARINT_UNSIGNED>(
+      value.unsafe_data(), value.size(), target);
 }
 inline uint8* WireFormatLite::WriteSInt32NoTagToArray(
     const RepeatedField< int32>& value, uint8* target) {
-  return WritePrimitiveNoTagToArray(value, WriteSInt32NoTagToArray, target);
+  return io::internal::EncodeVarintRun<io::internal::VARINT_ZIGZAG>(
+      value.unsafe_data(), value.size(), target);
 }
 inline uint8* WireFormatLite::WriteSInt64NoTagToArray(
     const RepeatedField< int64>& value, uint8* target) {
-  return WritePrimitiveNoTagToArray(value, WriteSInt64NoTagToArray, target);
+  return io::internal::EncodeVarintRun<io::internal::VARINT_ZIGZAG>(
+      value.unsafe_data(), value.size(), target);
 }
 inline uint8* WireFormatLite::WriteFixed32NoTagToArray(
     const RepeatedField<uint32>& value, uint8* target) {
@@ -756,7 +816,8 @@ inline uint8* WireFormatLite::WriteBoolNoTagToArray(
 }
 inline uint8* WireFormatLite::WriteEnumNoTagToArray(
     const RepeatedField<   int>& value, uint8* target) {
-  return WritePrimitiveNoTagToArray(value, WriteEnumNoTagToArray, target);
+  return io::internal::EncodeVarintRun<io::internal::VARINT_SIGN_EXTENDED>(
+      value.unsafe_data(), value.size(), target);
 }
 
 inline uint8* WireFormatLite::WriteInt32ToArray(int field_number,
@@ -1044,30 +1105,18 @@ inline size_t WireFormatLite::LengthDelimitedSize(size_t length) {
 }
 
 size_t WireFormatLite::Int64Size (const RepeatedField< int64>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += Int64Size(value.Get(i));
-  }
-  return out;
+  return io::internal::VarintRunSize<io::internal::VARINT_SIGN_EXTENDED>(
+      value.data(), value.size());
 }
 
 size_t WireFormatLite::UInt64Size(const RepeatedField<uint64>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += UInt64Size(value.Get(i));
-  }
-  return out;
+  return io::internal::VarintRunSize<io::internal::VARINT_UNSIGNED>(
+      value.data(), value.size());
 }
 
 size_t WireFormatLite::SInt64Size(const RepeatedField< int64>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += SInt64Size(value.Get(i));
-  }
-  return out;
+  return io::internal::VarintRunSize<io::internal::VARINT_ZIGZAG>(
+      value.data(), value.size());
 }
 
 }  // namespace internal